@@ -41,5 +41,9 @@ trap "rm -f test.log" EXIT INT
 test-library libmalloc-ff.so
 test-library libmalloc-bf.so
 test-library libmalloc-wf.so
+test-library libmalloc-ao.so
+test-library libmalloc-gf.so
+test-library libmalloc-bf-soa.so
+test-library libmalloc-wf-soa.so
 
 # vim: sts=4 sw=4 ts=8 ft=sh
@@ -74,6 +74,38 @@ external:    66.67
 EOF
 }
 
+libmalloc-ao.so-output() {
+    cat <<EOF
+blocks:      24
+free blocks: 4
+mallocs:     30
+frees:       10
+callocs:     0
+reallocs:    0
+reuses:      18
+grows:       12
+shrinks:     0
+splits:      12
+merges:      0
+requested:   5115
+heap size:   3976
+internal:    0.10
+external:    42.86
+EOF
+}
+
+libmalloc-gf.so-output() {
+    libmalloc-bf.so-output
+}
+
+libmalloc-bf-soa.so-output() {
+    libmalloc-bf.so-output
+}
+
+libmalloc-wf-soa.so-output() {
+    libmalloc-wf.so-output
+}
+
 # Main execution
 
 trap "rm -f test.log" EXIT INT
@@ -81,5 +113,9 @@ trap "rm -f test.log" EXIT INT
 test-library libmalloc-ff.so
 test-library libmalloc-bf.so
 test-library libmalloc-wf.so
+test-library libmalloc-ao.so
+test-library libmalloc-gf.so
+test-library libmalloc-bf-soa.so
+test-library libmalloc-wf-soa.so
 
 # vim: sts=4 sw=4 ts=8 ft=sh
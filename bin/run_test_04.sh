@@ -74,6 +74,38 @@ external:    37.50
 EOF
 }
 
+libmalloc-ao.so-output() {
+    cat <<EOF
+blocks:      1
+free blocks: 1
+mallocs:     6
+frees:       6
+callocs:     0
+reallocs:    0
+reuses:      1
+grows:       5
+shrinks:     0
+splits:      0
+merges:      4
+requested:   126
+heap size:   288
+internal:    84.72
+external:    0.00
+EOF
+}
+
+libmalloc-gf.so-output() {
+    libmalloc-bf.so-output
+}
+
+libmalloc-bf-soa.so-output() {
+    libmalloc-bf.so-output
+}
+
+libmalloc-wf-soa.so-output() {
+    libmalloc-wf.so-output
+}
+
 # Main execution
 
 trap "rm -f test.log" EXIT INT
@@ -81,5 +113,9 @@ trap "rm -f test.log" EXIT INT
 test-library libmalloc-ff.so
 test-library libmalloc-bf.so
 test-library libmalloc-wf.so
+test-library libmalloc-ao.so
+test-library libmalloc-gf.so
+test-library libmalloc-bf-soa.so
+test-library libmalloc-wf-soa.so
 
 # vim: sts=4 sw=4 ts=8 ft=sh
@@ -13,5 +13,11 @@ time-library() {
 time-library libmalloc-ff.so
 time-library libmalloc-bf.so
 time-library libmalloc-wf.so
+time-library libmalloc-ao.so
+time-library libmalloc-gf.so
+time-library libmalloc-cpu.so
+time-library libmalloc-bf-soa.so
+time-library libmalloc-wf-soa.so
+time-library libmalloc-buddy.so
 
 # vim: sts=4 sw=4 ts=8 ft=sh
@@ -0,0 +1,19 @@
+#!/bin/bash
+
+# Functions
+
+measure-library() {
+    library=$1
+    reuse=$2
+    echo -n "Measuring $library (MALLOC_HOT_REUSE=$reuse) ... "
+    env LD_PRELOAD=./lib/$library MALLOC_HOT_REUSE=$reuse ./bin/bench_cache 2>&1 > /dev/null
+}
+
+# Main execution
+
+for fit in ff bf gf; do
+    measure-library libmalloc-$fit.so 0
+    measure-library libmalloc-$fit.so 1
+done
+
+# vim: sts=4 sw=4 ts=8 ft=sh
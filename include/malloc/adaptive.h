@@ -0,0 +1,50 @@
+/* adaptive.h: Adaptive Fit Policy */
+
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* Adaptive Constants */
+
+#define ADAPTIVE_ENV        "MALLOC_ADAPTIVE"   /* Enable the adaptive policy */
+#define ADAPTIVE_INTERVAL   (1<<10)             /* Searches between samples */
+#define ADAPTIVE_FREE_HIGH  25                  /* Free (%) to fit tighter */
+#define ADAPTIVE_FREE_LOW   10                  /* Free (%) to search less */
+#define ADAPTIVE_STEPS_HIGH 64                  /* Blocks per search to search less */
+#define ADAPTIVE_VOTES      4                   /* Samples in a row to switch */
+
+/* Adaptive Policies (from the cheapest to the tightest) */
+
+enum {
+    ADAPTIVE_FF,        /* First fit */
+    ADAPTIVE_GF,        /* Good fit */
+    ADAPTIVE_BF,        /* Best fit */
+    ADAPTIVE_POLICIES,
+};
+
+/* Adaptive Variables */
+
+extern bool AdaptiveEnabled;    /* Whether the policy is chosen at run time */
+extern int  AdaptivePolicy;     /* Policy used by free_list_search */
+
+/* Adaptive Functions */
+
+void    adaptive_init();
+void    adaptive_sample();
+
+/**
+ * Name a policy (shared by the library and the mstat tool).
+ * @param   policy  Adaptive policy.
+ * @return  Short name of the policy (otherwise "?" if it is unknown).
+ **/
+static inline const char *adaptive_name(int policy) {
+    static const char *names[ADAPTIVE_POLICIES] = {"ff", "gf", "bf"};
+
+    return policy >= 0 && policy < ADAPTIVE_POLICIES ? names[policy] : "?";
+}
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,38 @@
+/* arena.h: Arena Structure */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "malloc/block.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/* Arena Structure */
+
+typedef struct arena Arena;
+struct arena {
+    pthread_mutex_t lock;       /* Protects the heap, free list, and counters */
+    Block *         remote;     /* Blocks freed while the lock was held */
+};
+
+/* Arena Variables */
+
+extern Arena MainArena;         /* Arena of the whole heap */
+
+/* Arena Functions */
+
+void    arena_init();
+void    arena_lock(Arena *arena);
+bool    arena_trylock(Arena *arena);
+void    arena_unlock(Arena *arena);
+
+void    arena_push(Arena *arena, Block *block);
+Block * arena_drain(Arena *arena);
+
+void    arena_free(Arena *arena, Block *block);
+void    arena_collect(Arena *arena);
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
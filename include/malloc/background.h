@@ -0,0 +1,24 @@
+/* background.h: Background Thread */
+
+#ifndef BACKGROUND_H
+#define BACKGROUND_H
+
+#include <stdbool.h>
+
+/* Background Constants */
+
+#define BACKGROUND_ENV      "MALLOC_BACKGROUND" /* Milliseconds between runs */
+#define BACKGROUND_DECAY    10                  /* Idle runs to purge all */
+
+/* Background Variables */
+
+extern bool BackgroundEnabled;  /* Whether housekeeping runs in a thread */
+
+/* Background Functions */
+
+void    background_init();
+void    background_run();
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -15,6 +15,20 @@
 #define ALIGN(size)     (((size) + (ALIGNMENT - 1)) & ~(ALIGNMENT - 1))
 #define SBRK_FAILURE    ((void *)(-1))
 #define TRIM_THRESHOLD  (1<<10)
+#define BASE_PAGE_SIZE  (1<<12)
+#define PAGE_ALIGN(size) \
+    (((size) + (BASE_PAGE_SIZE - 1)) & ~((size_t)BASE_PAGE_SIZE - 1))
+
+#define HUGE_PAGE_SIZE  (1<<21)
+#define HUGE_ALIGN(size) \
+    (((size) + (HUGE_PAGE_SIZE - 1)) & ~((size_t)HUGE_PAGE_SIZE - 1))
+#define HUGE_BLOCKS     (1<<8)          /* Maximum blocks mapped from hugetlb */
+#define HUGE_GUARD      ALIGNMENT       /* Gap at either end of hugetlb mappings */
+#define HUGE_PAGES_ENV  "MALLOC_HUGEPAGES"
+#define HUGE_TLB_ENV    "MALLOC_HUGETLB"
+
+#define RESERVE_ENV     "MALLOC_RESERVE"
+#define RESERVE_SIZE    (1UL<<35)       /* Address space reserved for heap */
 
 /* Block Structure */
 
@@ -32,15 +46,32 @@ struct block {
 #define BLOCK_FROM_POINTER(ptr) \
     (Block *)((intptr_t)(ptr) - sizeof(Block))
 
+/* Block Variables */
+
+extern bool   HugePages;    /* Whether heap grows in huge page extents */
+extern bool   HugeTLB;      /* Whether large blocks are mapped from hugetlb */
+extern bool   Reserved;     /* Whether heap is committed in a reservation */
+extern char * HeapStart;    /* Start of extents (or reservation) */
+extern char * HeapEnd;      /* End of extents (or committed pages) */
+
 /* Block Functions */
 
+void    block_init();
 Block * block_allocate(size_t size);
 bool    block_release(Block *block);
+Block * block_resize(Block *block, size_t size);
+bool    block_at_top(Block *block);
+size_t  block_purge(Block *block);
+size_t  block_prefault();
 
 Block * block_detach(Block *block);
 
 bool    block_merge(Block *dst, Block *src);
 Block * block_split(Block *block, size_t size);
+Block * block_align(Block *block, size_t alignment);
+
+size_t  block_carve(Block *block, size_t size, Block **blocks, size_t n);
+size_t  block_coalesce(Block **blocks, size_t n);
 
 #endif
 
@@ -0,0 +1,40 @@
+/* buddy.h: Buddy Allocator */
+
+#ifndef BUDDY_H
+#define BUDDY_H
+
+#include "malloc/block.h"
+
+#include <stdbool.h>
+
+/* Buddy Constants */
+
+#define BUDDY_MIN_ORDER     6                   /* Smallest block (64 bytes) */
+#define BUDDY_MAX_ORDER     20                  /* Chunk (1 MB) */
+#define BUDDY_ORDERS        (BUDDY_MAX_ORDER - BUDDY_MIN_ORDER + 1)
+#define BUDDY_CHUNK         (1UL<<BUDDY_MAX_ORDER)
+#define BUDDY_RESERVE       (1UL<<34)           /* Address space reserved */
+#define BUDDY_MAX_CAPACITY  (BUDDY_CHUNK - sizeof(Block))
+
+/* Buddy Variables */
+
+extern bool BuddyEnabled;           /* Whether small blocks come from buddies */
+
+/* Buddy Functions */
+
+void    buddy_init();
+bool    buddy_owns(Block *block);
+
+Block * buddy_search(size_t size);
+Block * buddy_take(Block *block, size_t size);
+size_t  buddy_padding(size_t alignment, size_t size);
+Block * buddy_align(Block *block, size_t alignment, size_t size);
+void    buddy_insert(Block *block);
+
+size_t  buddy_length();
+size_t  buddy_bytes();
+Block * buddy_largest();
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,15 @@
+/* bulk.h: Bulk Allocation */
+
+#ifndef BULK_H
+#define BULK_H
+
+#include <stdlib.h>
+
+/* Bulk Functions */
+
+size_t  malloc_bulk(size_t size, size_t n, void **ptrs);
+void    free_bulk(size_t n, void **ptrs);
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
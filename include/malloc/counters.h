@@ -25,6 +25,42 @@ enum {
     MERGES,	    /* Number of times a block was merged */
     REQUESTED,	    /* Total number of bytes requested by user */
     HEAP_SIZE,	    /* Size of the heap */
+    HUGE_HEAP,	    /* Bytes of heap reserved in huge page extents */
+    HUGE_TLB,	    /* Bytes of blocks mapped from hugetlb pool */
+    REMOTE_FREES,   /* Number of frees deferred to the arena lock holder */
+    DRAINS,	    /* Number of times the remote queue was drained */
+    DRAINED,	    /* Number of blocks freed by draining the remote queue */
+    DRAIN_MAX,	    /* Largest number of blocks drained at once */
+    BULK_MALLOCS,   /* Number of blocks allocated by malloc_bulk */
+    BULK_FREES,	    /* Number of blocks freed by free_bulk */
+    BULK_RUNS,	    /* Number of contiguous runs carved by malloc_bulk */
+    FAST_FREES,	    /* Number of blocks pushed onto the fast bins */
+    FAST_REUSES,    /* Number of blocks popped from the fast bins */
+    CONSOLIDATES,   /* Number of times the fast bins were consolidated */
+    BACKGROUND_RUNS,/* Number of runs of the background thread */
+    BACKGROUND_NS,  /* CPU time used by the background thread (ns) */
+    PURGED,	    /* Bytes of free blocks given back with MADV_DONTNEED */
+    PREFAULTED,	    /* Bytes of huge page extents faulted in ahead */
+    REGION_ALLOCS,  /* Number of allocations from regions */
+    REGION_BYTES,   /* Bytes allocated from regions */
+    REGION_CHUNKS,  /* Number of chunks taken by regions */
+    REGION_RESETS,  /* Number of times a region was reset or destroyed */
+    EXACT_HITS,	    /* Number of searches answered by the exact fit index */
+    EXACT_MISSES,   /* Number of searches that fell back to the policy */
+    COMMITTED,	    /* Bytes of the reservation committed with mprotect */
+    DECOMMITTED,    /* Bytes of the reservation given back to the kernel */
+    SEGMENT_MAPS,   /* Number of segments mapped */
+    SEGMENT_UNMAPS, /* Number of segments unmapped once empty */
+    SEGMENT_BYTES,  /* Bytes of segments currently mapped */
+    FOREIGN_POINTERS,/* Number of pointers ignored since they are not ours */
+    PAGEMAP_BYTES,  /* Bytes of page map nodes */
+    REMAPS,	    /* Number of blocks resized by realloc with mremap */
+    REMAPPED,	    /* Bytes realloc kept with mremap instead of copying */
+    SEARCHES,	    /* Number of free list searches by the policy */
+    SEARCH_STEPS,   /* Number of blocks visited by those searches */
+    FREE_BYTES,	    /* Bytes of blocks (with headers) in the free list */
+    POLICY_SWITCHES,/* Number of times the adaptive policy switched */
+    BUDDY_WASTE,    /* Bytes lost to rounding by buddy blocks in use */
     NCOUNTERS,	    /* Number of counters */
 };
 
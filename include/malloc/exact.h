@@ -0,0 +1,50 @@
+/* exact.h: Exact Fit Index */
+
+#ifndef EXACT_H
+#define EXACT_H
+
+#include "malloc/block.h"
+
+#include <stdbool.h>
+
+/* Exact Fit Constants */
+
+#define EXACT_ENV       "MALLOC_EXACT"  /* Enable the exact fit index */
+#define EXACT_BITS      10              /* Bits of the bucket number */
+#define EXACT_BUCKETS   (1<<EXACT_BITS)
+#define EXACT_PROBES    8               /* Buckets tried for a capacity */
+#define EXACT_MIN       (sizeof(size_t) + sizeof(ExactLink))
+
+/* Exact Fit Structures */
+
+typedef struct exact_link ExactLink;
+struct exact_link {
+    Block * next;       /* Next free block with the same capacity */
+    Block **pprev;      /* Pointer that points to this block (NULL if not indexed) */
+};
+
+typedef struct exact_entry ExactEntry;
+struct exact_entry {
+    size_t  capacity;   /* Capacity of the blocks in the stack (0 if unused) */
+    Block * head;       /* Free block with this capacity inserted last */
+};
+
+/* Exact Fit Macros */
+
+#define EXACT_LINK(block) \
+    ((ExactLink *)((block)->data + sizeof(size_t)))  /* Past the index slot */
+
+/* Exact Fit Variables */
+
+extern bool ExactEnabled;               /* Whether the index is maintained */
+
+/* Exact Fit Functions */
+
+void    exact_init();
+void    exact_insert(Block *block);
+void    exact_remove(Block *block, size_t capacity);
+Block * exact_search(size_t size);
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,34 @@
+/* fastbins.h: Fast Bins */
+
+#ifndef FASTBINS_H
+#define FASTBINS_H
+
+#include "malloc/block.h"
+
+#include <stdbool.h>
+
+/* Fast Bins Constants */
+
+#define FASTBINS_ENV        "MALLOC_FASTBINS"   /* Largest capacity to bin */
+#define FASTBINS_MAX        1024                /* Largest capacity allowed */
+#define FASTBINS            (FASTBINS_MAX / ALIGNMENT)
+#define FASTBINS_THRESHOLD  (1<<16)             /* Binned bytes to consolidate */
+
+/* Fast Bins Variables */
+
+extern bool FastBinsEnabled;    /* Whether small frees skip the free list */
+
+/* Fast Bins Functions */
+
+void    fastbins_init();
+bool    fastbins_push(Block *block);
+Block * fastbins_pop(size_t size);
+size_t  fastbins_consolidate();
+
+size_t  fastbins_length();
+size_t  fastbins_bytes();
+Block * fastbins_largest();
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -5,10 +5,37 @@
 
 #include "malloc/block.h"
 
+#include <stdbool.h>
+
+/* Free List Constants */
+
+#define HOT_REUSE_ENV           "MALLOC_HOT_REUSE"          /* Enable LIFO */
+
+/* Good Fit Constants */
+
+#define GOODFIT_SLACK_ENV       "MALLOC_GOODFIT_SLACK"      /* Tolerance (%) */
+#define GOODFIT_CANDIDATES_ENV  "MALLOC_GOODFIT_CANDIDATES" /* Blocks to try */
+#define GOODFIT_SLACK           3                           /* Default (%) */
+#define GOODFIT_SLACK_MAX       100                         /* Largest (%) */
+#define GOODFIT_CANDIDATES      128                         /* Default */
+
+/* Free List Variables */
+
+extern bool   HotReuse;             /* Whether freed blocks go to the front */
+
+/* Good Fit Variables */
+
+extern size_t GoodFitSlack;         /* Waste accepted without looking further */
+extern size_t GoodFitCandidates;    /* Fitting blocks tried before giving up */
+
 /* Free List Functions */
 
+void    free_list_init();
 Block *	free_list_search(size_t size);
 void	free_list_insert(Block *block);
+void	free_list_insert_ao(Block *block);
+void	free_list_insert_unordered(Block *block);
+Block *	free_list_take(Block *block, size_t size);
 size_t  free_list_length();
 
 #endif
@@ -0,0 +1,38 @@
+/* index.h: Capacity Index */
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "malloc/block.h"
+
+#include <stdbool.h>
+
+/* Index Constants */
+
+#define INDEX_SLOTS     (1<<12)         /* Initial number of slots */
+#define INDEX_ISA_ENV   "MALLOC_INDEX_ISA"  /* Force "scalar" or "sse4" kernel */
+
+/* Index Macros */
+
+#define INDEX_SLOT(block) \
+    (*(size_t *)((block)->data))        /* Slot of free block in the index */
+
+/* Index Variables */
+
+extern bool         IndexEnabled;       /* Whether the index is maintained */
+extern const char * IndexKernel;        /* Name of the search kernel */
+
+/* Index Functions */
+
+void    index_init();
+void    index_insert(Block *block);
+void    index_remove(Block *block);
+void    index_replace(Block *old_block, Block *new_block);
+void    index_update(Block *block);
+
+Block * index_search_bf(size_t size);
+Block * index_search_wf(size_t size);
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
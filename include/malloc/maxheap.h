@@ -0,0 +1,47 @@
+/* maxheap.h: Max-Heap Index */
+
+#ifndef MAXHEAP_H
+#define MAXHEAP_H
+
+#include "malloc/block.h"
+
+#include <stdbool.h>
+
+/* Max-Heap Constants */
+
+#define MAXHEAP_SLOTS   (1<<12)         /* Initial number of slots */
+
+/* Max-Heap Macros */
+
+#define MAXHEAP_SLOT(block) \
+    (*(size_t *)((block)->data))        /* Slot of free block in the heap */
+
+/* Max-Heap Structure */
+
+typedef struct heap_node HeapNode;
+struct heap_node {
+    size_t  capacity;   /* Capacity of block (copied to keep sifts local) */
+    size_t  order;      /* Position of block in the free list */
+    Block * block;      /* Pointer to free block */
+};
+
+/* Max-Heap Variables */
+
+extern bool MaxHeapEnabled;             /* Whether the heap is maintained */
+
+/* Max-Heap Functions */
+
+void    maxheap_init();
+void    maxheap_insert(Block *block);
+void    maxheap_remove(Block *block);
+void    maxheap_replace(Block *old_block, Block *new_block);
+void    maxheap_update(Block *block);
+
+Block * maxheap_peek();
+Block * maxheap_search(size_t size);
+size_t  maxheap_length();
+size_t  maxheap_bytes();
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,39 @@
+/* pagemap.h: Page Map */
+
+#ifndef PAGEMAP_H
+#define PAGEMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Page Map Constants */
+
+#define PAGEMAP_ENV         "MALLOC_PAGEMAP"    /* Enable the page map */
+#define PAGEMAP_PAGE_SHIFT  12                  /* Bits of offset in page */
+#define PAGEMAP_BITS        12                  /* Bits of page per level */
+#define PAGEMAP_FANOUT      (1<<PAGEMAP_BITS)
+#define PAGEMAP_MASK        (PAGEMAP_FANOUT - 1)
+
+/* Page Map Kinds */
+
+enum {
+    PAGEMAP_NONE,       /* Page is not ours */
+    PAGEMAP_HEAP,       /* Page holds blocks of the heap */
+    PAGEMAP_BUDDY,      /* Page holds blocks of the buddy system */
+};
+
+/* Page Map Variables */
+
+extern bool PageMapEnabled;             /* Whether pages of blocks are mapped */
+
+/* Page Map Functions */
+
+void    pagemap_init();
+bool    pagemap_mark(const void *start, size_t length, uint8_t kind);
+void    pagemap_clear(const void *start, size_t length);
+uint8_t pagemap_lookup(const void *address);
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
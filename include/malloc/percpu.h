@@ -0,0 +1,53 @@
+/* percpu.h: Per-CPU Caches */
+
+#ifndef PERCPU_H
+#define PERCPU_H
+
+#include "malloc/block.h"
+#include "malloc/stats.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/* Per-CPU Constants */
+
+#define PERCPU_CLASS        16                  /* Bytes between size classes */
+#define PERCPU_CLASSES      16                  /* Number of size classes */
+#define PERCPU_MAX          (PERCPU_CLASS * PERCPU_CLASSES)
+#define PERCPU_SHIFT        6
+#define PERCPU_DEPTH        (1<<PERCPU_SHIFT)   /* Blocks per class per CPU */
+#define PERCPU_SIZE(size) \
+    (((size) + (PERCPU_CLASS - 1)) & ~((size_t)PERCPU_CLASS - 1))
+
+/* Per-CPU Cache Structure */
+
+typedef struct cpu_cache CpuCache;
+struct cpu_cache {
+    size_t          count[PERCPU_CLASSES];                  /* Cached blocks */
+    Block *         slots[PERCPU_CLASSES][PERCPU_DEPTH];    /* Stacks */
+    size_t          mallocs;    /* Number of mallocs served by cache */
+    size_t          frees;      /* Number of frees kept by cache */
+    size_t          requested;  /* Bytes requested from cache */
+    pthread_mutex_t lock;       /* Protects cache when rseq is unavailable */
+} __attribute__((aligned(64)));
+
+/* Per-CPU Variables */
+
+extern bool PerCpuEnabled;      /* Whether small blocks are cached per CPU */
+extern bool PerCpuRseq;         /* Whether caches are accessed with rseq */
+
+/* Per-CPU Functions */
+
+void    percpu_init();
+Block * percpu_pop(size_t size);
+bool    percpu_push(Block *block);
+bool    percpu_push_sized(Block *block, size_t size);
+void    percpu_collect();
+size_t  percpu_length();
+size_t  percpu_bytes();
+size_t  percpu_publish(StatsCpu *cpus, size_t n);
+void    percpu_dump(int fd);
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
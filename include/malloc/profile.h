@@ -0,0 +1,46 @@
+/* profile.h: Sampling Heap Profiler */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* Profile Constants */
+
+#define PROFILE_ENV         "MALLOC_PROFILE"        /* Path of heap profile */
+#define PROFILE_RATE_ENV    "MALLOC_PROFILE_RATE"   /* Mean bytes per sample */
+#define PROFILE_SIGNAL_ENV  "MALLOC_PROFILE_SIGNAL" /* Signal to dump profile */
+#define PROFILE_RATE        (1<<19)                 /* Default bytes per sample */
+#define PROFILE_DEPTH       32                      /* Frames per backtrace */
+#define PROFILE_SAMPLES     (1<<12)                 /* Live samples tracked */
+#define PROFILE_SLOTS       (PROFILE_SAMPLES<<1)    /* Sample table size */
+#define PROFILE_SKIP        2                       /* Frames inside malloc */
+#define PROFILE_INNER       4                       /* Most frames inside library */
+
+/* Sample Structure */
+
+typedef struct sample Sample;
+struct sample {
+    void *  ptr;                    /* Sampled allocation (NULL if empty) */
+    size_t  size;                   /* Number of bytes requested */
+    int     depth;                  /* Number of frames in stack */
+    void *  stack[PROFILE_DEPTH];   /* Backtrace of the allocation */
+};
+
+/* Profile Variables */
+
+extern bool   ProfileEnabled;       /* Whether or not allocations are sampled */
+extern size_t ProfileLive;          /* Number of live samples */
+
+/* Profile Functions */
+
+void    profile_init();
+void    profile_malloc(void *ptr, size_t size);
+void    profile_free(void *ptr);
+void    profile_move(void *from, void *to);
+bool    profile_dump(const char *path);
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,36 @@
+/* region.h: Regions */
+
+#ifndef REGION_H
+#define REGION_H
+
+#include "malloc/block.h"
+
+#include <stdlib.h>
+
+/* Region Constants */
+
+#define REGION_CHUNK    (1<<16)                 /* Capacity of a chunk */
+#define REGION_LARGE    (REGION_CHUNK / 4)      /* Size that gets own chunk */
+
+/* Region Structure */
+
+typedef struct region Region;
+struct region {
+    Block * first;      /* Chunk that holds the region itself */
+    Block * chunks;     /* Other chunks (linked through next) */
+    char *  cursor;     /* Next free byte of the current chunk */
+    char *  end;        /* End of the current chunk */
+    size_t  allocs;     /* Allocations not yet added to the counters */
+    size_t  bytes;      /* Bytes not yet added to the counters */
+};
+
+/* Region Functions */
+
+Region *region_create();
+void *  region_alloc(Region *region, size_t size);
+void    region_reset(Region *region);
+void    region_destroy(Region *region);
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,47 @@
+/* segment.h: Segmented Heap */
+
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include "malloc/block.h"
+
+#include <stdbool.h>
+
+/* Segment Constants */
+
+#define SEGMENTS_ENV    "MALLOC_SEGMENTS"   /* Size of segments (MiB) */
+#define SEGMENT_MIN     (1UL<<20)           /* Smallest segment allowed */
+#define SEGMENT_MAX     (1UL<<26)           /* Largest segment allowed */
+#define SEGMENT_LARGE   8                   /* Fraction for own segment */
+#define SEGMENT_GUARD   ALIGNMENT           /* Gap before first block */
+#define SEGMENTS_MAX    (1<<16)             /* Maximum mapped segments */
+
+/* Segment Structure */
+
+typedef struct segment Segment;
+struct segment {
+    char *  start;      /* Start of mapping */
+    char *  top;        /* End of last block carved from segment */
+    size_t  length;     /* Length of mapping */
+    size_t  free;       /* Bytes of blocks (with headers) in free list */
+};
+
+/* Segment Variables */
+
+extern bool SegmentsEnabled;            /* Whether heap is made of segments */
+
+/* Segment Functions */
+
+void      segment_init();
+Segment * segment_find(const void *address);
+Block *   segment_allocate(size_t allocated);
+bool      segment_release(Block *block);
+Block *   segment_resize(Block *block, size_t allocated);
+bool      segment_at_top(Block *block);
+void      segment_free(Segment *segment, size_t bytes);
+void      segment_take(Block *block);
+size_t    segment_count();
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
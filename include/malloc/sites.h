@@ -0,0 +1,43 @@
+/* sites.h: Per Call Site Statistics */
+
+#ifndef SITES_H
+#define SITES_H
+
+#include "malloc/block.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* Sites Constants */
+
+#define SITES_ENV       "MALLOC_SITES"  /* Number of top call sites to dump */
+#define SITES_SLOTS     (1<<10)         /* Call sites tracked (power of two) */
+#define SITES_TOP       (1<<6)          /* Maximum call sites to dump */
+
+/* Site Structure */
+
+typedef struct site Site;
+struct site {
+    void *  address;    /* Return address of the caller (NULL if empty) */
+    size_t  mallocs;    /* Number of allocations from call site */
+    size_t  bytes;      /* Number of bytes requested from call site */
+    size_t  live;       /* Number of bytes requested and not yet freed */
+    size_t  grows;      /* Number of heap grows caused by call site */
+    size_t  splits;     /* Number of block splits caused by call site */
+};
+
+/* Sites Variables */
+
+extern bool SitesEnabled;   /* Whether or not call sites are tracked */
+
+/* Sites Functions */
+
+void    sites_init();
+void    sites_malloc(Block *block, void *address, size_t grows, size_t splits);
+void    sites_tag(Block *block, Site *site);
+Site *  sites_free(Block *block);
+void    sites_dump(int fd);
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
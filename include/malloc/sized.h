@@ -0,0 +1,15 @@
+/* sized.h: Sized Deallocation */
+
+#ifndef SIZED_H
+#define SIZED_H
+
+#include <stdlib.h>
+
+/* Sized Deallocation Functions */
+
+void    free_sized(void *ptr, size_t size);
+void    free_aligned_sized(void *ptr, size_t alignment, size_t size);
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
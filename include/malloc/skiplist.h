@@ -0,0 +1,33 @@
+/* skiplist.h: Skip List Index */
+
+#ifndef SKIPLIST_H
+#define SKIPLIST_H
+
+#include "malloc/block.h"
+
+#include <stdbool.h>
+
+/* Skip List Constants */
+
+#define SKIPLIST_LEVELS 16          /* Maximum number of levels */
+#define SKIPLIST_CHUNK  (1<<16)     /* Bytes of nodes mapped at once */
+
+/* Skip List Node Structure */
+
+typedef struct skip_node SkipNode;
+struct skip_node {
+    Block *     block;                      /* Indexed block (the key) */
+    SkipNode *  next[SKIPLIST_LEVELS];      /* Next node at each level */
+};
+
+/* Skip List Functions */
+
+bool    skiplist_insert(Block *block);
+bool    skiplist_remove(Block *block);
+bool    skiplist_replace(Block *old_block, Block *new_block);
+Block * skiplist_lower(Block *block);
+size_t  skiplist_length();
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
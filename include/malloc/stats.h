@@ -0,0 +1,81 @@
+/* stats.h: Shared Memory Statistics */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "malloc/counters.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Stats Constants */
+
+#define STATS_MAGIC     0x6d616c6c  /* Identifies a libmalloc stats page */
+#define STATS_VERSION   4           /* Layout version of the stats page */
+#define STATS_NAME      "/libmalloc.%d"
+#define STATS_ENV       "MALLOC_STATS"
+#define STATS_INTERVAL  (1<<10)     /* Updates between free list scans */
+#define STATS_SWITCHES  16          /* Policy switches kept in the log */
+#define STATS_ARENAS    1           /* Arenas broken down on the page */
+#define STATS_CPUS      64          /* CPU caches broken down on the page */
+
+/* Stats Structures */
+
+typedef struct stats_switch StatsSwitch;
+struct stats_switch {
+    uint64_t time;          /* CLOCK_MONOTONIC nanoseconds of the switch */
+    uint32_t from;          /* Adaptive policy before the switch */
+    uint32_t to;            /* Adaptive policy after the switch */
+    size_t   free_ratio;    /* Free bytes per 100 bytes of heap (sample) */
+    size_t   steps;         /* Blocks visited per search (sample) */
+};
+
+typedef struct stats_arena StatsArena;
+struct stats_arena {
+    size_t   remote_frees;  /* Frees deferred to the lock holder */
+    size_t   drains;        /* Number of times the remote queue was drained */
+    size_t   drained;       /* Blocks freed by draining the remote queue */
+    size_t   drain_max;     /* Largest number of blocks drained at once */
+    size_t   queued;        /* Blocks waiting in the remote queue */
+};
+
+typedef struct stats_cpu StatsCpu;
+struct stats_cpu {
+    size_t   mallocs;       /* Mallocs served by the cache (hits) */
+    size_t   frees;         /* Frees kept by the cache */
+    size_t   cached;        /* Blocks held by the cache */
+    size_t   cached_bytes;  /* Bytes held by the cache (by size class) */
+};
+
+typedef struct stats Stats;
+struct stats {
+    uint32_t magic;         /* STATS_MAGIC once the page is initialized */
+    uint32_t version;       /* STATS_VERSION of the writer */
+    uint32_t sequence;      /* Seqlock sequence (odd while being updated) */
+    uint32_t ncounters;     /* Number of entries in counters */
+    uint32_t narenas;       /* Number of entries in arenas */
+    uint32_t ncpus;         /* Number of entries in cpus (0 without caches) */
+    pid_t    pid;           /* Process that owns the page */
+    uint64_t started;       /* CLOCK_MONOTONIC nanoseconds at creation */
+    size_t   updates;       /* Number of times the page was published */
+    size_t   free_blocks;   /* Number of blocks in free list (last scan) */
+    size_t   free_bytes;    /* Capacity of all free blocks (last scan) */
+    size_t   largest_free;  /* Capacity of largest free block (last scan) */
+    size_t   switches;      /* Number of adaptive policy switches */
+    StatsSwitch log[STATS_SWITCHES];    /* Last switches (by switches) */
+    StatsArena  arenas[STATS_ARENAS];   /* Breakdown by arena */
+    StatsCpu    cpus[STATS_CPUS];       /* Breakdown by per-CPU cache */
+    size_t   counters[NCOUNTERS];
+};
+
+/* Stats Functions */
+
+void    stats_init();
+void    stats_publish();
+void    stats_switch(int from, int to, size_t free_ratio, size_t steps);
+void    stats_fini();
+
+#endif
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,93 @@
+/* adaptive.c: Adaptive Fit Policy
+ *
+ * When ADAPTIVE_ENV is set, free_list_search ignores the policy the library
+ * was built with and uses the policy of AdaptivePolicy instead, which moves
+ * along a ladder from the cheapest and loosest policy (first fit) to the
+ * tightest and most expensive one (best fit), with good fit in between:
+ *
+ *  1. Every ADAPTIVE_INTERVAL searches, the free bytes per 100 bytes of heap
+ *  (FREE_BYTES is kept by the free list as blocks enter and leave it) and the
+ *  blocks visited per search since the last sample are read.
+ *  2. A sample with at least ADAPTIVE_FREE_HIGH percent of the heap free votes
+ *  for a tighter policy, and a sample with at most ADAPTIVE_FREE_LOW percent
+ *  free but long searches votes for a cheaper one.
+ *  3. The policy moves one step once ADAPTIVE_VOTES samples in a row vote the
+ *  same way (any other sample starts over).
+ *
+ * The band between the two thresholds and the votes keep a workload that sits
+ * on the edge from flipping back and forth.  Worst fit is left out, since it
+ * neither fits tighter nor searches less than any policy of the ladder.
+ *
+ * Every switch is counted and logged to the stats page (see stats_switch).
+ **/
+
+#include "malloc/adaptive.h"
+#include "malloc/counters.h"
+#include "malloc/stats.h"
+
+#include <string.h>
+
+/* Global Variables */
+
+bool            AdaptiveEnabled  = false;
+int             AdaptivePolicy   = ADAPTIVE_FF;
+
+static size_t   AdaptiveSearches = 0;   /* Searches at last sample */
+static size_t   AdaptiveSteps    = 0;   /* Blocks visited at last sample */
+static int      AdaptiveVotes    = 0;   /* Votes in a row (negative for cheaper) */
+
+/* Functions */
+
+/**
+ * Enable the adaptive policy if the ADAPTIVE_ENV environment variable is set
+ * (and not "0"), starting with first fit.
+ *
+ * Note, this should only be called once (from init_counters).
+ **/
+void    adaptive_init() {
+    char *adaptive = getenv(ADAPTIVE_ENV);
+
+    AdaptiveEnabled = adaptive && *adaptive && strcmp(adaptive, "0");
+    AdaptivePolicy  = ADAPTIVE_FF;
+}
+
+/**
+ * Sample the free bytes and search length once ADAPTIVE_INTERVAL searches
+ * went by since the last sample, and switch the policy if enough samples in a
+ * row asked for it.
+ *
+ * Note, this requires the MainArena lock.
+ **/
+void    adaptive_sample() {
+    size_t searches = Counters[SEARCHES] - AdaptiveSearches;
+    if (searches < ADAPTIVE_INTERVAL) {
+        return;
+    }
+
+    size_t steps      = (Counters[SEARCH_STEPS] - AdaptiveSteps) / searches;
+    size_t free_ratio = Counters[HEAP_SIZE] ? Counters[FREE_BYTES] * 100 / Counters[HEAP_SIZE] : 0;
+
+    AdaptiveSearches = Counters[SEARCHES];
+    AdaptiveSteps    = Counters[SEARCH_STEPS];
+
+    int vote = 0;
+    if (free_ratio >= ADAPTIVE_FREE_HIGH && AdaptivePolicy < ADAPTIVE_POLICIES - 1) {
+        vote = 1;
+    } else if (free_ratio <= ADAPTIVE_FREE_LOW && steps >= ADAPTIVE_STEPS_HIGH && AdaptivePolicy > ADAPTIVE_FF) {
+        vote = -1;
+    }
+
+    AdaptiveVotes = vote * AdaptiveVotes > 0 ? AdaptiveVotes + vote : vote;
+    if (abs(AdaptiveVotes) < ADAPTIVE_VOTES) {
+        return;
+    }
+
+    int from = AdaptivePolicy;
+    AdaptivePolicy += vote;
+    AdaptiveVotes   = 0;
+
+    Counters[POLICY_SWITCHES]++;
+    stats_switch(from, AdaptivePolicy, free_ratio, steps);
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,187 @@
+/* arena.c: Arena Implementation
+ *
+ * The MainArena owns the whole heap and is protected by a recursive lock (so
+ * that calloc, realloc, and memalign can call malloc and free while holding
+ * it).
+ *
+ * A thread that frees a block while another thread holds the lock does not
+ * wait for it.  Instead, the block is pushed onto the remote queue of the
+ * arena, a lock-free multiple producer, single consumer stack linked through
+ * the next field of the blocks.  The lock holder takes the whole queue at once
+ * with an atomic exchange (so there is no ABA problem) and frees the batch
+ * during its next malloc (or the next run of the background thread).
+ **/
+
+#define _GNU_SOURCE     /* For PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP */
+
+#include "malloc/arena.h"
+#include "malloc/counters.h"
+#include "malloc/fastbins.h"
+#include "malloc/freelist.h"
+#include "malloc/profile.h"
+#include "malloc/sites.h"
+
+/* Global Variables */
+
+Arena MainArena = {PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP, NULL};
+
+/* Functions */
+
+/**
+ * Acquire the MainArena lock before fork.
+ **/
+static void arena_prepare() {
+    arena_lock(&MainArena);
+}
+
+/**
+ * Release the MainArena lock after fork in the parent.
+ **/
+static void arena_release() {
+    arena_unlock(&MainArena);
+}
+
+/**
+ * Reset the MainArena lock after fork in the child.
+ *
+ * Note, the lock cannot simply be released there: the forking thread has a
+ * new thread id in the child, so it no longer owns the (recursive) lock.
+ **/
+static void arena_child() {
+    pthread_mutex_t lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+    MainArena.lock = lock;
+}
+
+/**
+ * Register fork handlers so that the child never inherits a lock held by a
+ * thread that does not exist in the child.
+ *
+ * Note, this should only be called once (from init_counters).
+ **/
+void    arena_init() {
+    pthread_atfork(arena_prepare, arena_release, arena_child);
+}
+
+/**
+ * Acquire the lock of the arena (waiting if necessary).
+ * @param   arena   Pointer to arena.
+ **/
+void    arena_lock(Arena *arena) {
+    pthread_mutex_lock(&arena->lock);
+}
+
+/**
+ * Try to acquire the lock of the arena without waiting.
+ * @param   arena   Pointer to arena.
+ * @return  Whether or not the lock was acquired.
+ **/
+bool    arena_trylock(Arena *arena) {
+    return pthread_mutex_trylock(&arena->lock) == 0;
+}
+
+/**
+ * Release the lock of the arena.
+ * @param   arena   Pointer to arena.
+ **/
+void    arena_unlock(Arena *arena) {
+    pthread_mutex_unlock(&arena->lock);
+}
+
+/**
+ * Push a freed block onto the remote queue of the arena.
+ *
+ * Note, this does not require the lock of the arena.
+ *
+ * @param   arena   Pointer to arena.
+ * @param   block   Pointer to block being freed.
+ **/
+void    arena_push(Arena *arena, Block *block) {
+    Block *head = __atomic_load_n(&arena->remote, __ATOMIC_RELAXED);
+
+    do {
+        block->next = head;
+    } while (!__atomic_compare_exchange_n(&arena->remote, &head, block, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    __atomic_fetch_add(&Counters[REMOTE_FREES], 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Take all the blocks in the remote queue of the arena.
+ *
+ * Note, this requires the lock of the arena.
+ *
+ * @param   arena   Pointer to arena.
+ * @return  NULL-terminated list of blocks linked through next (otherwise NULL
+ * if the queue is empty).
+ **/
+Block * arena_drain(Arena *arena) {
+    if (!__atomic_load_n(&arena->remote, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+
+    Block *head  = __atomic_exchange_n(&arena->remote, NULL, __ATOMIC_ACQUIRE);
+    size_t batch = 0;
+    for (Block *curr = head; curr; curr = curr->next) {
+        batch++;
+    }
+
+    Counters[DRAINS]++;
+    Counters[DRAINED] += batch;
+    if (batch > Counters[DRAIN_MAX]) {
+        Counters[DRAIN_MAX] = batch;
+    }
+    return head;
+}
+
+/**
+ * Release an allocated block back to the heap (or the free list).
+ *
+ * Note, this requires the lock of the arena.
+ *
+ * @param   arena   Pointer to arena.
+ * @param   block   Pointer to block being freed.
+ **/
+void    arena_free(Arena *arena, Block *block) {
+    // Update counters
+    Counters[FREES]++;
+
+    if (ProfileLive) {
+        profile_free(block->data);
+    }
+
+    if (SitesEnabled) {
+        sites_free(block);
+    }
+
+    // Defer merging a small block until the fast bins are consolidated
+    if (FastBinsEnabled && fastbins_push(block)) {
+        return;
+    }
+
+    // Try to release block, otherwise insert it into the free list
+    if (!block_release(block)) {
+        free_list_insert(block);
+    }
+}
+
+/**
+ * Free the batch of blocks that other threads pushed onto the remote queue of
+ * the arena while it was locked.
+ *
+ * Note, this requires the lock of the arena.
+ *
+ * @param   arena   Pointer to arena.
+ **/
+void    arena_collect(Arena *arena) {
+    Block *curr = arena_drain(arena);
+
+    while (curr) {
+        Block *next = curr->next;
+        curr->next  = curr;
+        arena_free(arena, curr);
+        curr = next;
+    }
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,184 @@
+/* background.c: Background Thread
+ *
+ * When BACKGROUND_ENV is set, a thread wakes up every that many milliseconds
+ * and does the housekeeping that would otherwise happen inside malloc and
+ * free (or not at all):
+ *
+ *  1. Free the blocks in the remote queue of the MainArena.
+ *  2. Once the program has been idle (no mallocs or frees) for a whole run:
+ *      - Consolidate the fast bins.
+ *      - Trim the free blocks at the top of the heap.
+ *      - Purge the pages of the free blocks, a BACKGROUND_DECAY fraction of
+ *        the free memory more for every idle run (so memory that is about to
+ *        be reused is not purged right away).
+ *  3. Prefault the unused end of the huge page extents.
+ *
+ * The CPU time of each run is added to the BACKGROUND_NS counter.
+ **/
+
+#include "malloc/arena.h"
+#include "malloc/background.h"
+#include "malloc/block.h"
+#include "malloc/counters.h"
+#include "malloc/fastbins.h"
+#include "malloc/freelist.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+
+/* Global Variables */
+
+extern Block FreeList;
+
+bool            BackgroundEnabled  = false;
+static long     BackgroundInterval = 0;         /* Milliseconds between runs */
+static size_t   BackgroundActivity = 0;         /* Mallocs and frees seen */
+static size_t   BackgroundIdle     = 0;         /* Idle runs in a row */
+static size_t   BackgroundPurged   = 0;         /* Free blocks purged */
+
+/* Functions */
+
+/**
+ * Release the free blocks at the top of the heap (as long as they meet the
+ * trim threshold).
+ **/
+static void background_trim() {
+    for (Block *curr = FreeList.next; curr != &FreeList; curr = curr->next) {
+        if (!block_at_top(curr)) {
+            continue;
+        }
+
+        Block *block = free_list_take(curr, curr->capacity);
+        if (!block_release(block)) {
+            free_list_insert(block);
+            return;
+        }
+
+        // The block below may be free as well
+        curr = &FreeList;
+    }
+}
+
+/**
+ * Purge the free blocks (in free list order) until the given fraction of the
+ * free memory has been purged since the program went idle.
+ * @param   runs    Number of idle runs (out of BACKGROUND_DECAY).
+ **/
+static void background_purge(size_t runs) {
+    size_t free_bytes = 0;
+    for (Block *curr = FreeList.next; curr != &FreeList; curr = curr->next) {
+        free_bytes += curr->capacity;
+    }
+
+    size_t target = free_bytes / BACKGROUND_DECAY * (runs < BACKGROUND_DECAY ? runs : BACKGROUND_DECAY);
+    size_t bytes  = 0;
+    size_t blocks = 0;
+    for (Block *curr = FreeList.next; curr != &FreeList && bytes < target; curr = curr->next, blocks++) {
+        bytes += curr->capacity;
+
+        // The free list does not change while idle, so skip purged blocks
+        if (blocks >= BackgroundPurged) {
+            Counters[PURGED] += block_purge(curr);
+        }
+    }
+
+    BackgroundPurged = blocks > BackgroundPurged ? blocks : BackgroundPurged;
+}
+
+/**
+ * Do one run of housekeeping (see above) while holding the MainArena lock.
+ **/
+void    background_run() {
+    struct timespec start;
+    struct timespec end;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    arena_lock(&MainArena);
+
+    arena_collect(&MainArena);
+
+    size_t activity = Counters[MALLOCS] + Counters[FREES] + Counters[CALLOCS] + Counters[REALLOCS];
+    if (activity != BackgroundActivity) {
+        BackgroundActivity = activity;
+        BackgroundIdle     = 0;
+        BackgroundPurged   = 0;
+    } else {
+        if (!BackgroundIdle++ && FastBinsEnabled) {
+            fastbins_consolidate();
+        }
+
+        background_trim();
+
+        // Purging part of a huge page would split it
+        if (!HugePages) {
+            background_purge(BackgroundIdle);
+        }
+    }
+
+    Counters[PREFAULTED] += block_prefault();
+    Counters[BACKGROUND_RUNS]++;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    Counters[BACKGROUND_NS] += (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec);
+    arena_unlock(&MainArena);
+}
+
+/**
+ * Sleep for the interval and do a run of housekeeping, forever.
+ **/
+static void *background_thread(void *arg) {
+    struct timespec interval = {BackgroundInterval / 1000, (BackgroundInterval % 1000) * 1000000L};
+
+    for (;;) {
+        nanosleep(&interval, NULL);
+        background_run();
+    }
+
+    return NULL;
+}
+
+/**
+ * Stop doing housekeeping in the child after fork (the thread does not exist
+ * there).
+ **/
+static void background_child() {
+    BackgroundEnabled = false;
+}
+
+/**
+ * Start the background thread if the BACKGROUND_ENV environment variable is
+ * set to a positive number of milliseconds.
+ *
+ * Note, the thread blocks all signals (so that it never runs the handlers of
+ * the program or the profiler), and this should only be called once (from
+ * init_counters).
+ **/
+void    background_init() {
+    char *interval = getenv(BACKGROUND_ENV);
+    if (!interval || atol(interval) <= 0) {
+        return;
+    }
+
+    sigset_t all;
+    sigset_t old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+
+    pthread_attr_t attributes;
+    pthread_t      thread;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+
+    BackgroundInterval = atol(interval);
+    BackgroundEnabled  = pthread_create(&thread, &attributes, background_thread, NULL) == 0;
+
+    pthread_attr_destroy(&attributes);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (BackgroundEnabled) {
+        pthread_atfork(NULL, NULL, background_child);
+    }
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -1,18 +1,318 @@
-/* block.c: Block Structure */
+/* block.c: Block Structure
+ *
+ * By default, the heap grows and shrinks by moving the program break with
+ * sbrk.  When RESERVE_ENV is set, a RESERVE_SIZE range of address space is
+ * reserved (PROT_NONE) with mmap instead, and the heap commits its pages with
+ * mprotect as it grows and decommits them as it shrinks, so that it does not
+ * share the program break with anyone else.
+ *
+ * When SEGMENTS_ENV is set, the heap is made of separately mapped segments
+ * instead (see segment.c), and the settings above only apply to hugetlb.
+ *
+ * Blocks that have a mapping of their own (from hugetlb or a segment of their
+ * own) are resized with mremap, which moves their pages instead of copying
+ * them.
+ **/
+
+#define _GNU_SOURCE     /* For mremap */
 
 #include "malloc/block.h"
 #include "malloc/counters.h"
+#include "malloc/exact.h"
+#include "malloc/pagemap.h"
+#include "malloc/segment.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
+/* Global Variables */
+
+bool    HugePages   = false;
+bool    HugeTLB     = false;
+bool    Reserved    = false;
+char *  HeapStart   = NULL;
+char *  HeapEnd     = NULL;
+
+static char *  HeapTop = NULL;              /* End of last block in extents */
+static char *  HeapLimit = NULL;            /* End of reservation */
+static char *  HeapFaulted = NULL;          /* End of prefaulted extents */
+static Block * HugeBlocks[HUGE_BLOCKS];     /* Blocks mapped from hugetlb */
+static size_t  HugeBlocksCount = 0;
+static bool    HugeTLBFailed   = false;     /* Whether hugetlb pool is empty */
+
+/* Functions */
+
+/**
+ * Reserve RESERVE_SIZE bytes of address space (aligned to HUGE_PAGE_SIZE)
+ * for the heap without committing any of it.
+ * @return  Whether or not the address space was reserved.
+ **/
+static bool block_reserve() {
+    size_t length = RESERVE_SIZE + HUGE_PAGE_SIZE;
+    char * start  = mmap(NULL, length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (start == MAP_FAILED) {
+        return false;
+    }
+
+    char *aligned = (char *)HUGE_ALIGN((uintptr_t)start);
+    if (aligned > start) {
+        munmap(start, aligned - start);
+    }
+    munmap(aligned + RESERVE_SIZE, start + length - (aligned + RESERVE_SIZE));
+
+    HeapStart = HeapTop = HeapEnd = aligned;
+    HeapLimit = aligned + RESERVE_SIZE;
+    return true;
+}
+
+/**
+ * Read the heap settings from the environment:
+ *
+ *  - HUGE_PAGES_ENV:   Grow the heap in HUGE_PAGE_SIZE aligned extents that
+ *                      are advised with MADV_HUGEPAGE.
+ *  - HUGE_TLB_ENV:     Map blocks of at least HUGE_PAGE_SIZE with MAP_HUGETLB
+ *                      (falling back to the heap when that fails).
+ *  - RESERVE_ENV:      Commit the heap in a reservation instead of using sbrk
+ *                      (falling back to sbrk when the reservation fails).
+ *  - SEGMENTS_ENV:     Map the heap in segments (see segment_init).
+ *
+ * Note, this should only be called once (from init_counters).
+ **/
+void    block_init() {
+    char *huge_pages = getenv(HUGE_PAGES_ENV);
+    char *huge_tlb   = getenv(HUGE_TLB_ENV);
+    char *reserve    = getenv(RESERVE_ENV);
+
+    HugePages = huge_pages && *huge_pages && strcmp(huge_pages, "0");
+    HugeTLB   = huge_tlb   && *huge_tlb   && strcmp(huge_tlb, "0");
+    Reserved  = reserve    && *reserve    && strcmp(reserve, "0") && block_reserve();
+    segment_init();
+}
+
+/**
+ * Map a block of the specified size (with a HUGE_GUARD gap at either end,
+ * rounded up to HUGE_PAGE_SIZE) from the hugetlb pool.
+ *
+ * Note, if no huge pages are available, HugeTLBFailed is set so that later
+ * allocations do not keep trying.
+ *
+ * @param   allocated   Pointer to number of bytes to map (updated to the
+ * number of bytes the block actually got).
+ * @return  Pointer to mapped block (otherwise SBRK_FAILURE).
+ **/
+static Block *block_map_huge(size_t *allocated) {
+    if (HugeBlocksCount == HUGE_BLOCKS) {
+        return SBRK_FAILURE;
+    }
+
+    size_t length = HUGE_ALIGN(*allocated + 2 * HUGE_GUARD);
+    char * start  = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (start == MAP_FAILED) {
+        HugeTLBFailed = true;
+        return SBRK_FAILURE;
+    }
+
+    // Leave a gap at either end so the block never merges with its neighbors
+    Block *block = (Block *)(start + HUGE_GUARD);
+    HugeBlocks[HugeBlocksCount++] = block;
+    Counters[HUGE_TLB] += length;
+    *allocated = length - 2 * HUGE_GUARD;
+    return block;
+}
+
+/**
+ * Attempt to unmap a block that was mapped from the hugetlb pool.
+ *
+ * Note, blocks that were split (e.g. by block_align) no longer cover their
+ * whole mapping and are left to the free list instead.
+ *
+ * @param   block       Pointer to block to unmap.
+ * @return  Whether or not the block was unmapped.
+ **/
+static bool block_unmap_huge(Block *block) {
+    for (size_t i = 0; i < HugeBlocksCount; i++) {
+        if (HugeBlocks[i] != block) {
+            continue;
+        }
+
+        size_t length = sizeof(Block) + block->capacity + 2 * HUGE_GUARD;
+        if (length != HUGE_ALIGN(length) || munmap((char *)block - HUGE_GUARD, length) < 0) {
+            return false;
+        }
+
+        pagemap_clear(block, length - 2 * HUGE_GUARD);
+        HugeBlocks[i] = HugeBlocks[--HugeBlocksCount];
+        Counters[HUGE_TLB]  -= length;
+        Counters[HEAP_SIZE] -= length - 2 * HUGE_GUARD;
+        Counters[BLOCKS]--;
+        Counters[SHRINKS]++;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Attempt to resize a block that was mapped from the hugetlb pool.
+ *
+ * Note, mremap of hugetlb mappings needs a recent kernel, so the caller must
+ * be ready for this to fail.
+ *
+ * @param   block       Pointer to block to resize.
+ * @param   allocated   Number of bytes the block needs (including the header).
+ * @return  Pointer to resized block (otherwise NULL).
+ **/
+static Block *block_remap_huge(Block *block, size_t allocated) {
+    for (size_t i = 0; i < HugeBlocksCount; i++) {
+        if (HugeBlocks[i] != block) {
+            continue;
+        }
+
+        size_t length  = sizeof(Block) + block->capacity + 2 * HUGE_GUARD;
+        size_t resized = HUGE_ALIGN(allocated + 2 * HUGE_GUARD);
+        if (length != HUGE_ALIGN(length) || resized < allocated) {
+            return NULL;
+        }
+
+        char *start = (char *)block - HUGE_GUARD;
+        char *moved = resized == length ? start : mremap(start, length, resized, MREMAP_MAYMOVE);
+        if (moved == MAP_FAILED) {
+            return NULL;
+        }
+
+        Block *remapped = (Block *)(moved + HUGE_GUARD);
+        pagemap_clear(block, length - 2 * HUGE_GUARD);
+        pagemap_mark(remapped, resized - 2 * HUGE_GUARD, PAGEMAP_HEAP);
+        remapped->capacity = resized - 2 * HUGE_GUARD - sizeof(Block);
+        HugeBlocks[i] = remapped;
+        Counters[HUGE_TLB]  += resized - length;
+        Counters[HEAP_SIZE] += resized - length;
+        return remapped;
+    }
+
+    return NULL;
+}
+
+/**
+ * Commit the specified number of bytes at the end of the reservation.
+ * @param   grow    Number of bytes to commit (page aligned).
+ * @return  Whether or not the bytes were committed.
+ **/
+static bool block_commit(size_t grow) {
+    if (grow > (size_t)(HeapLimit - HeapEnd) || mprotect(HeapEnd, grow, PROT_READ | PROT_WRITE) < 0) {
+        return false;
+    }
+
+    Counters[COMMITTED] += grow;
+    return true;
+}
+
+/**
+ * Decommit the end of the reservation starting at the specified address (the
+ * pages are dropped and the address space stays reserved).
+ * @param   keep    Start of bytes to decommit (page aligned).
+ * @return  Whether or not the bytes were decommitted.
+ **/
+static bool block_decommit(char *keep) {
+    size_t length = HeapEnd - keep;
+    if (mmap(keep, length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) == MAP_FAILED) {
+        return false;
+    }
+
+    Counters[COMMITTED]   -= length;
+    Counters[DECOMMITTED] += length;
+    return true;
+}
+
+/**
+ * Carve a block from the end of the extents, growing them when needed:
+ *
+ *  - With huge pages, by whole HUGE_PAGE_SIZE extents (advised with
+ *    MADV_HUGEPAGE).
+ *  - Otherwise, by whole pages.
+ *
+ * The extents are committed in the reservation if there is one, and taken from
+ * the program break otherwise.
+ *
+ * Note, with the program break the first extent (or the first one after
+ * someone else moved the program break) is aligned to HUGE_PAGE_SIZE by
+ * skipping the misaligned part of the break.
+ *
+ * @param   allocated   Number of bytes to allocate.
+ * @return  Pointer to carved block (otherwise SBRK_FAILURE).
+ **/
+static Block *block_extend(size_t allocated) {
+    if (!Reserved) {
+        char *brk = sbrk(0);
+        if (brk == SBRK_FAILURE) {
+            return SBRK_FAILURE;
+        }
+
+        if (brk != HeapEnd) {
+            char *aligned = (char *)HUGE_ALIGN((intptr_t)brk);
+            if (sbrk(aligned - brk) == SBRK_FAILURE) {
+                return SBRK_FAILURE;
+            }
+            HeapStart = HeapStart ? HeapStart : aligned;
+            HeapTop   = HeapEnd = aligned;
+        }
+    }
+
+    if (allocated > (size_t)(HeapEnd - HeapTop)) {
+        size_t needed = allocated - (HeapEnd - HeapTop);
+        size_t grow   = HugePages ? HUGE_ALIGN(needed) : PAGE_ALIGN(needed);
+        if (grow < needed || (intptr_t)grow < 0) {
+            return SBRK_FAILURE;
+        }
+
+        if (Reserved ? !block_commit(grow) : sbrk(grow) == SBRK_FAILURE) {
+            return SBRK_FAILURE;
+        }
+
+        if (HugePages) {
+            madvise(HeapEnd, grow, MADV_HUGEPAGE);
+            Counters[HUGE_HEAP] += grow;
+        }
+        HeapEnd += grow;
+    }
+
+    Block *block = (Block *)HeapTop;
+    HeapTop += allocated;
+    return block;
+}
+
+/**
+ * Give back the end of the extents, decommitting it (or shrinking the program
+ * break) by whole extents (one spare extent is kept to avoid thrashing).
+ *
+ * @param   allocated   Number of bytes released from the end of the extents.
+ **/
+static void block_shrink(size_t allocated) {
+    HeapTop -= allocated;
+
+    char *keep = HugePages ? (char *)HUGE_ALIGN((intptr_t)HeapTop) + HUGE_PAGE_SIZE
+                           : (char *)PAGE_ALIGN((intptr_t)HeapTop) + BASE_PAGE_SIZE;
+    if (HeapEnd > keep && (Reserved ? block_decommit(keep) : sbrk(0) == HeapEnd && sbrk(keep - HeapEnd) != SBRK_FAILURE)) {
+        if (HugePages) {
+            Counters[HUGE_HEAP] -= HeapEnd - keep;
+        }
+        HeapEnd = keep;
+    }
+
+    if (HeapFaulted > HeapEnd) {
+        HeapFaulted = HeapEnd;
+    }
+}
+
 /**
  * Allocate a new block on the heap using sbrk:
  *
  *  1. Determined aligned amount of memory to allocate.
- *  2. Allocate memory on the heap.
+ *  2. Allocate memory on the heap (or from huge pages or the reservation if
+ *  enabled).
  *  3. Set allocage block properties.
  *
  * @param   size    Number of bytes to allocate.
@@ -20,18 +320,38 @@
  **/
 Block *	block_allocate(size_t size) {
     // Allocate block
-    intptr_t allocated = sizeof(Block) + ALIGN(size);
-    Block *  block     = sbrk(allocated);
+    size_t   allocated = sizeof(Block) + ALIGN(size);
+    Block *  block     = SBRK_FAILURE;
+
+    // Refuse sizes that wrap around (or that sbrk would take as negative)
+    if (allocated < size || allocated > PTRDIFF_MAX) {
+        return NULL;
+    }
+    if (HugeTLB && !HugeTLBFailed && allocated >= HUGE_PAGE_SIZE) {
+        block = block_map_huge(&allocated);
+    }
+
+    if (block == SBRK_FAILURE) {
+        if (SegmentsEnabled) {
+            block = segment_allocate(allocated);
+        } else {
+            block = HugePages || Reserved ? block_extend(allocated) : sbrk(allocated);
+        }
+    }
+
     if (block == SBRK_FAILURE) {
     	return NULL;
     }
 
     // Record block information
-    block->capacity = ALIGN(size);
+    block->capacity = allocated - sizeof(Block);
     block->size     = size;
     block->prev     = block;
     block->next     = block;
 
+    // Record pages of block
+    pagemap_mark(block, allocated, PAGEMAP_HEAP);
+
     // Update counters
     Counters[HEAP_SIZE] += allocated;
     Counters[BLOCKS]++;
@@ -42,28 +362,36 @@ Block *	block_allocate(size_t size) {
 /**
  * Attempt to release memory used by block to heap:
  *
- *  1. If the block is at the end of the heap.
- *  2. The block capacity meets the trim threshold.
+ *  1. If the block was mapped from hugetlb, then unmap it.
+ *  2. If the heap is made of segments, then let its segment release it.
+ *  3. If the block is at the end of the heap.
+ *  4. The block capacity meets the trim threshold.
  *
  * @param   block   Pointer to block to release.
  * @return  Whether or not the release completed successfully.
  **/
 bool	block_release(Block *block) {
-    // TODO: Implement block release
-    // size_t allocated = 0;
-    // Counters[BLOCKS]--;
-    // Counters[SHRINKS]++;
-    // Counters[HEAP_SIZE] -= allocated;
-    
     size_t  allocated = 0;
 
-    if ( (block->data + block->capacity) == sbrk(0) && (block->capacity + sizeof(Block)) > TRIM_THRESHOLD ) {
+    if (HugeBlocksCount && block_unmap_huge(block)) {
+        return true;
+    }
+
+    if (SegmentsEnabled) {
+        return segment_release(block);
+    }
+
+    if ( block_at_top(block) && (block->capacity + sizeof(Block)) > TRIM_THRESHOLD ) {
         //Release
         allocated = sizeof(Block) + block->capacity;
-        if (sbrk(-1*allocated) == SBRK_FAILURE) {
+        if (HugePages || Reserved) {
+            block_shrink(allocated);
+        } else if (sbrk(-1*allocated) == SBRK_FAILURE) {
             return false;
         }
 
+        pagemap_clear(block, allocated);
+
         Counters[BLOCKS]--;
         Counters[SHRINKS]++;
         Counters[HEAP_SIZE] -= allocated;
@@ -74,6 +402,110 @@ bool	block_release(Block *block) {
     return false;
 }
 
+/**
+ * Attempt to grow or shrink an allocated block without copying its data:
+ *
+ *  1. If the block was mapped from hugetlb, then remap it.
+ *  2. If the block has a segment of its own, then remap the segment.
+ *
+ * Note, the block may move (its header and data move with it).
+ *
+ * @param   block   Pointer to allocated block.
+ * @param   size    Number of bytes the block must hold.
+ * @return  Pointer to resized block (otherwise NULL if it has no mapping of
+ * its own or the mapping could not be resized).
+ **/
+Block * block_resize(Block *block, size_t size) {
+    size_t allocated = sizeof(Block) + ALIGN(size);
+    size_t kept      = block->capacity < size ? block->capacity : size;
+    Block *resized   = NULL;
+
+    if (allocated < size) {
+        return NULL;
+    }
+
+    if (HugeBlocksCount) {
+        resized = block_remap_huge(block, allocated);
+    }
+
+    if (!resized && SegmentsEnabled) {
+        resized = segment_resize(block, allocated);
+    }
+
+    if (!resized) {
+        return NULL;
+    }
+
+    resized->size = size;
+    Counters[REMAPS]++;
+    Counters[REMAPPED] += kept;
+    return resized;
+}
+
+/**
+ * Return whether or not the specified block ends at the top of the heap (or
+ * of the current segment).
+ * @param   block   Pointer to block.
+ **/
+bool    block_at_top(Block *block) {
+    if (SegmentsEnabled) {
+        return segment_at_top(block);
+    }
+
+    char *heap_end = HugePages || Reserved ? HeapTop : sbrk(0);
+
+    return block->data + block->capacity == heap_end;
+}
+
+/**
+ * Give the whole pages of a free block back to the kernel with MADV_DONTNEED
+ * (they read as zero the next time they are touched).
+ *
+ * Note, the first words of the data are kept since the free list indexes store
+ * the slot of the block (and the exact fit links) there.
+ *
+ * @param   block   Pointer to free block.
+ * @return  Number of bytes purged.
+ **/
+size_t  block_purge(Block *block) {
+    uintptr_t start = ((uintptr_t)block->data + EXACT_MIN + BASE_PAGE_SIZE - 1) & ~((uintptr_t)BASE_PAGE_SIZE - 1);
+    uintptr_t end   = ((uintptr_t)block->data + block->capacity) & ~((uintptr_t)BASE_PAGE_SIZE - 1);
+
+    if (end <= start || madvise((void *)start, end - start, MADV_DONTNEED) < 0) {
+        return 0;
+    }
+
+    return end - start;
+}
+
+/**
+ * Fault in the unused end of the huge page extents, so that the next blocks
+ * carved from it do not take the page faults.
+ *
+ * Note, without huge pages the heap grows by exactly what each block needs,
+ * so there is nothing to prefault.
+ *
+ * @return  Number of bytes prefaulted.
+ **/
+size_t  block_prefault() {
+    if (!HugePages || !HeapTop) {
+        return 0;
+    }
+
+    char *start = HeapFaulted > HeapTop ? HeapFaulted : HeapTop;
+    start = (char *)(((uintptr_t)start + BASE_PAGE_SIZE - 1) & ~((uintptr_t)BASE_PAGE_SIZE - 1));
+    if (start >= HeapEnd) {
+        return 0;
+    }
+
+    for (volatile char *page = start; page < HeapEnd; page += BASE_PAGE_SIZE) {
+        *page = 0;
+    }
+
+    HeapFaulted = HeapEnd;
+    return HeapEnd - start;
+}
+
 /**
  * Detach specified block from its neighbors.
  *
@@ -81,8 +513,6 @@ bool	block_release(Block *block) {
  * @return  Pointer to detached block.
  **/
 Block * block_detach(Block *block) {
-    // TODO: Detach block from neighbors by updating previous and next block
-
     if(block) {
 
         Block *before = block->prev;
@@ -111,10 +541,6 @@ Block * block_detach(Block *block) {
  * @return  Whether or not the merge completed successfully.
  **/
 bool	block_merge(Block *dst, Block *src) {
-    // TODO: Implement block merge
-    // Counters[MERGES]++;
-    // Counters[BLOCKS]--;
-    
     if( (Block *)(dst->data + dst->capacity) == src) {
         dst->capacity += ALIGN(src->capacity + sizeof(Block));
 
@@ -140,10 +566,6 @@ bool	block_merge(Block *dst, Block *src) {
  * @return  Pointer to original block (regardless if it was split or not).
  **/
 Block * block_split(Block *block, size_t size) {
-    // TODO: Implement block split
-    // Counters[SPLITS]++;
-    // Counters[BLOCKS]++;
-    
     if ( (ALIGN(size) + sizeof(*block)) < block->capacity ) {
         Block *new_block = (Block *)(block->data + ALIGN(size));
 
@@ -166,4 +588,138 @@ Block * block_split(Block *block, size_t size) {
     return block;
 }
 
+/**
+ * Attempt to align the data of the block to the specified alignment:
+ *
+ *  1. Compute the first aligned data address that leaves room for a new block
+ *  header and a minimal prefix block in front of it.
+ *
+ *  2. Split the misaligned prefix off the specified block so that it can be
+ *  returned to the free list.
+ *
+ * @param   block       Pointer to block to align (its size must be set).
+ * @param   alignment   Desired alignment of the data (power of two).
+ * @return  Pointer to aligned block (the original block if it was already
+ * aligned, otherwise NULL if the block is too small to be aligned).
+ **/
+Block * block_align(Block *block, size_t alignment) {
+    intptr_t data = (intptr_t)block->data;
+    if (data % alignment == 0) {
+        return block;
+    }
+
+    intptr_t aligned = (data + sizeof(Block) + ALIGNMENT + alignment - 1) & ~(alignment - 1);
+    size_t   offset  = aligned - data;
+    if (offset + ALIGN(block->size) > block->capacity) {
+        return NULL;
+    }
+
+    Block *new_block = BLOCK_FROM_POINTER(aligned);
+
+    new_block->capacity = block->capacity - offset;
+    new_block->size     = block->size;
+    new_block->prev     = new_block;
+    new_block->next     = new_block;
+
+    block->capacity = offset - sizeof(Block);
+    block->size     = block->capacity;
+
+    Counters[SPLITS]++;
+    Counters[BLOCKS]++;
+    return new_block;
+}
+
+/**
+ * Carve a detached block into a contiguous run of blocks of the specified
+ * size (any slack left at the end is given to the last block).
+ * @param   block   Pointer to detached block to carve.
+ * @param   size    Number of bytes requested for each block.
+ * @param   blocks  Array to store the carved blocks in.
+ * @param   n       Maximum number of blocks to carve.
+ * @return  Number of blocks carved (at least one).
+ **/
+size_t  block_carve(Block *block, size_t size, Block **blocks, size_t n) {
+    size_t stride = sizeof(Block) + ALIGN(size);
+    size_t count  = 1 + (block->capacity - ALIGN(size)) / stride;
+    char * end    = block->data + block->capacity;
+
+    if (count > n) {
+        count = n;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        Block *curr = (Block *)((char *)block + i * stride);
+
+        curr->capacity = i + 1 < count ? ALIGN(size) : (size_t)(end - curr->data);
+        curr->size     = size;
+        curr->prev     = curr;
+        curr->next     = curr;
+        blocks[i]      = curr;
+    }
+
+    Counters[BLOCKS] += count - 1;
+    return count;
+}
+
+/**
+ * Move the block at the specified root of a max-heap (ordered by address)
+ * down until both of its children are lower.
+ **/
+static void block_sift(Block **blocks, size_t root, size_t n) {
+    for (size_t child = 2 * root + 1; child < n; root = child, child = 2 * root + 1) {
+        if (child + 1 < n && blocks[child] < blocks[child + 1]) {
+            child++;
+        }
+
+        if (blocks[root] > blocks[child]) {
+            break;
+        }
+
+        Block *swap   = blocks[root];
+        blocks[root]  = blocks[child];
+        blocks[child] = swap;
+    }
+}
+
+/**
+ * Sort blocks by address (heapsort, since qsort may allocate memory).
+ * @param   blocks  Array of blocks.
+ * @param   n       Number of blocks.
+ **/
+static void block_sort(Block **blocks, size_t n) {
+    for (size_t root = n / 2; root-- > 0; ) {
+        block_sift(blocks, root, n);
+    }
+
+    for (size_t end = n; end-- > 1; ) {
+        Block *swap = blocks[0];
+        blocks[0]   = blocks[end];
+        blocks[end] = swap;
+        block_sift(blocks, 0, end);
+    }
+}
+
+/**
+ * Coalesce a batch of detached blocks in a single pass:
+ *
+ *  1. Sort the blocks by address.
+ *  2. Merge every block into the previous one if they are adjacent.
+ *
+ * @param   blocks  Array of blocks (replaced by the coalesced blocks).
+ * @param   n       Number of blocks.
+ * @return  Number of coalesced blocks at the front of the array.
+ **/
+size_t  block_coalesce(Block **blocks, size_t n) {
+    size_t count = 0;
+
+    block_sort(blocks, n);
+    for (size_t i = 0; i < n; i++) {
+        if (!count || !block_merge(blocks[count - 1], blocks[i])) {
+            blocks[count++] = blocks[i];
+        }
+    }
+
+    return count;
+}
+
 /* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,357 @@
+/* buddy.c: Buddy Allocator
+ *
+ * When built with BUDDY, every request that fits in BUDDY_CHUNK is served by
+ * a binary buddy system instead of the free list:
+ *
+ *  - Blocks (including their header) are powers of two between
+ *    2^BUDDY_MIN_ORDER and 2^BUDDY_MAX_ORDER bytes, aligned to their size
+ *    within a range of address space reserved up front (and committed one
+ *    chunk at a time).
+ *
+ *  - The buddy of a block of order k is found by flipping bit k of its
+ *    offset, and a per-order bitmap says whether that buddy is free (with the
+ *    same order), so merging on free is O(1) per order instead of a scan.
+ *
+ *  - Free blocks of each order are kept in their own doubly-linked list, so a
+ *    search only looks at the head of the lists from the requested order up.
+ *
+ * The price is internal fragmentation: a request is rounded up to the next
+ * power of two (including the header), and BUDDY_WASTE keeps the bytes lost to
+ * the rounding of the blocks in use.  Larger requests (and the runs of
+ * malloc_bulk, which need a block they can carve) go to the heap and the free
+ * list as usual.
+ *
+ * Since blocks are aligned to their size, an aligned request takes a block at
+ * least twice the alignment and moves the header in front of the aligned data
+ * (see buddy_align).  Such a header is never 2^BUDDY_MIN_ORDER aligned (unlike
+ * the blocks themselves), so buddy_insert can find the block it lives in.
+ **/
+
+#include "malloc/buddy.h"
+#include "malloc/counters.h"
+#include "malloc/pagemap.h"
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+/* Global Variables */
+
+bool                BuddyEnabled = false;
+static char *       BuddyBase    = NULL;        /* Start of reserved space */
+static char *       BuddyTop     = NULL;        /* End of committed chunks */
+static uint64_t *   BuddyBitmaps[BUDDY_ORDERS]; /* Free blocks of each order */
+static Block        BuddyLists[BUDDY_ORDERS];   /* Free lists of each order */
+static size_t       BuddyCount   = 0;           /* Number of free blocks */
+static size_t       BuddyBytes   = 0;           /* Capacity of free blocks */
+
+/* Functions */
+
+/**
+ * Return the order of the smallest block that fits the specified size.
+ * @param   size    Amount of memory required (at most BUDDY_MAX_CAPACITY).
+ **/
+static inline size_t buddy_order(size_t size) {
+    size_t order = 64 - __builtin_clzl(size + sizeof(Block) - 1);
+    return order < BUDDY_MIN_ORDER ? BUDDY_MIN_ORDER : order;
+}
+
+/**
+ * Return the order of the specified buddy block.
+ **/
+static inline size_t buddy_order_of(Block *block) {
+    return __builtin_ctzl(block->capacity + sizeof(Block));
+}
+
+/**
+ * Return the buddy block that holds the specified block (which is the block
+ * itself, unless buddy_align moved its header).
+ **/
+static inline Block *buddy_block_of(Block *block) {
+    if (((char *)block - BuddyBase) % (1UL << BUDDY_MIN_ORDER) == 0) {
+        return block;
+    }
+
+    // The data ends with the buddy block, which is more than twice as large
+    char * end   = block->data + block->capacity;
+    size_t order = 64 - __builtin_clzl(end - (char *)block - 1);
+    return (Block *)(end - (1UL << order));
+}
+
+/**
+ * Return the bit of the specified block in the bitmap of the given order.
+ **/
+static inline size_t buddy_bit(Block *block, size_t order) {
+    return ((char *)block - BuddyBase) >> order;
+}
+
+/**
+ * Return whether or not the specified block is free with the given order.
+ **/
+static inline bool buddy_is_free(Block *block, size_t order) {
+    size_t bit = buddy_bit(block, order);
+    return BuddyBitmaps[order - BUDDY_MIN_ORDER][bit / 64] & (1UL << (bit % 64));
+}
+
+/**
+ * Add the specified block to the free list and bitmap of the given order.
+ **/
+static void buddy_push(Block *block, size_t order) {
+    Block *list = &BuddyLists[order - BUDDY_MIN_ORDER];
+    size_t bit  = buddy_bit(block, order);
+
+    block->capacity  = (1UL << order) - sizeof(Block);
+    block->prev      = list;
+    block->next      = list->next;
+    list->next->prev = block;
+    list->next       = block;
+
+    BuddyBitmaps[order - BUDDY_MIN_ORDER][bit / 64] |= 1UL << (bit % 64);
+    BuddyCount++;
+    BuddyBytes += block->capacity;
+}
+
+/**
+ * Remove the specified block from the free list and bitmap of the given
+ * order.
+ **/
+static void buddy_pop(Block *block, size_t order) {
+    size_t bit = buddy_bit(block, order);
+
+    block->prev->next = block->next;
+    block->next->prev = block->prev;
+    block->prev       = block;
+    block->next       = block;
+
+    BuddyBitmaps[order - BUDDY_MIN_ORDER][bit / 64] &= ~(1UL << (bit % 64));
+    BuddyCount--;
+    BuddyBytes -= block->capacity;
+}
+
+/**
+ * Commit the next chunk of the reserved space as a free block of the largest
+ * order.
+ * @return  Pointer to free block (otherwise NULL if no memory is available).
+ **/
+static Block *buddy_grow() {
+    if (BuddyTop == BuddyBase + BUDDY_RESERVE) {
+        return NULL;
+    }
+
+    if (mprotect(BuddyTop, BUDDY_CHUNK, PROT_READ | PROT_WRITE) < 0) {
+        return NULL;
+    }
+
+    Block *block = (Block *)BuddyTop;
+    pagemap_mark(block, BUDDY_CHUNK, PAGEMAP_BUDDY);
+    BuddyTop += BUDDY_CHUNK;
+    buddy_push(block, BUDDY_MAX_ORDER);
+    block->size = block->capacity;
+
+    Counters[HEAP_SIZE] += BUDDY_CHUNK;
+    Counters[BLOCKS]++;
+    Counters[GROWS]++;
+    return block;
+}
+
+/**
+ * Reserve the address space and map the bitmaps of the buddy system.
+ *
+ * Note, this should only be called once (from init_counters when built with
+ * BUDDY).
+ **/
+void    buddy_init() {
+    size_t bitmaps = 0;
+    for (size_t order = BUDDY_MIN_ORDER; order <= BUDDY_MAX_ORDER; order++) {
+        bitmaps += BUDDY_RESERVE >> order >> 3;
+    }
+
+    // Pages of the bitmaps are only faulted in for the committed chunks
+    char *reserved = mmap(NULL, BUDDY_RESERVE + BUDDY_CHUNK, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    char *bitmap   = mmap(NULL, bitmaps, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved == MAP_FAILED || bitmap == MAP_FAILED) {
+        return;
+    }
+
+    for (size_t order = BUDDY_MIN_ORDER; order <= BUDDY_MAX_ORDER; order++) {
+        Block *list = &BuddyLists[order - BUDDY_MIN_ORDER];
+        list->capacity = -1;
+        list->size     = -1;
+        list->prev     = list;
+        list->next     = list;
+
+        BuddyBitmaps[order - BUDDY_MIN_ORDER] = (uint64_t *)bitmap;
+        bitmap += BUDDY_RESERVE >> order >> 3;
+    }
+
+    BuddyBase    = (char *)(((uintptr_t)reserved + BUDDY_CHUNK - 1) & ~(BUDDY_CHUNK - 1));
+    BuddyTop     = BuddyBase;
+    BuddyEnabled = true;
+}
+
+/**
+ * Return whether or not the specified block belongs to the buddy system.
+ * @param   block   Pointer to block.
+ **/
+bool    buddy_owns(Block *block) {
+    return BuddyBase && (char *)block >= BuddyBase && (char *)block < BuddyTop;
+}
+
+/**
+ * Search for the free block of the smallest order (at least the one that fits
+ * the specified size), committing a new chunk if there is none.
+ * @param   size    Amount of memory required (at most BUDDY_MAX_CAPACITY).
+ * @return  Pointer to free block (otherwise NULL if no memory is available).
+ **/
+Block * buddy_search(size_t size) {
+    for (size_t order = buddy_order(size); order <= BUDDY_MAX_ORDER; order++) {
+        Block *list = &BuddyLists[order - BUDDY_MIN_ORDER];
+        if (list->next != list) {
+            list->next->size = size;
+            Counters[REUSES]++;
+            return list->next;
+        }
+    }
+
+    Block *block = buddy_grow();
+    if (block) {
+        block->size = size;
+    }
+    return block;
+}
+
+/**
+ * Take a block returned by buddy_search out of its free list, splitting it in
+ * halves (and freeing the upper ones) down to the order that fits the
+ * specified size.
+ * @param   block   Pointer to free block.
+ * @param   size    Amount of memory required.
+ * @return  Pointer to detached block.
+ **/
+Block * buddy_take(Block *block, size_t size) {
+    size_t order  = buddy_order_of(block);
+    size_t target = buddy_order(size);
+
+    buddy_pop(block, order);
+    while (order > target) {
+        order--;
+
+        Block *half = (Block *)((char *)block + (1UL << order));
+        buddy_push(half, order);
+        half->size = half->capacity;
+
+        Counters[SPLITS]++;
+        Counters[BLOCKS]++;
+    }
+
+    block->capacity = (1UL << target) - sizeof(Block);
+    block->size     = size;
+
+    Counters[BUDDY_WASTE] += block->capacity - size;
+    return block;
+}
+
+/**
+ * Return the amount of memory to add to the specified size so that the block
+ * taken for it can be aligned by buddy_align.
+ * @param   alignment   Alignment of the data (power of two).
+ * @param   size        Amount of memory required.
+ * @return  Number of bytes of padding.
+ **/
+size_t  buddy_padding(size_t alignment, size_t size) {
+    // The data right after the header is aligned to the size of the header
+    if (alignment <= sizeof(Block)) {
+        return 0;
+    }
+
+    // Otherwise the data starts one alignment into a block twice as large
+    size_t length = alignment + (size > alignment ? size : alignment);
+    return length - sizeof(Block) - size;
+}
+
+/**
+ * Align the data of a block taken for the specified size plus buddy_padding,
+ * moving its header in front of the aligned data (if needed).
+ * @param   block       Pointer to block taken from the buddy system.
+ * @param   alignment   Alignment of the data (power of two).
+ * @param   size        Amount of memory required.
+ * @return  Pointer to aligned block.
+ **/
+Block * buddy_align(Block *block, size_t alignment, size_t size) {
+    // The padding is lost to the rounding as well
+    Counters[BUDDY_WASTE] += block->size - size;
+    block->size = size;
+
+    if ((uintptr_t)block->data % alignment == 0) {
+        return block;
+    }
+
+    Block *aligned = (Block *)((char *)block + alignment - sizeof(Block));
+
+    aligned->capacity = block->capacity + sizeof(Block) - alignment;
+    aligned->size     = size;
+    aligned->prev     = aligned;
+    aligned->next     = aligned;
+    return aligned;
+}
+
+/**
+ * Insert the specified block (or the buddy block that holds it) into the free
+ * list of its order, merging it with its buddy for as long as the buddy is
+ * free.
+ * @param   block   Pointer to block to free.
+ **/
+void    buddy_insert(Block *block) {
+    block = buddy_block_of(block);
+    Counters[BUDDY_WASTE] -= block->capacity - block->size;
+
+    size_t order = buddy_order_of(block);
+
+    while (order < BUDDY_MAX_ORDER) {
+        Block *buddy = (Block *)(BuddyBase + (((char *)block - BuddyBase) ^ (1UL << order)));
+        if (!buddy_is_free(buddy, order)) {
+            break;
+        }
+
+        buddy_pop(buddy, order);
+        if (buddy < block) {
+            block = buddy;
+        }
+        order++;
+
+        Counters[MERGES]++;
+        Counters[BLOCKS]--;
+    }
+
+    buddy_push(block, order);
+}
+
+/**
+ * Return the number of free buddy blocks.
+ **/
+size_t  buddy_length() {
+    return BuddyCount;
+}
+
+/**
+ * Return the capacity of all the free buddy blocks.
+ **/
+size_t  buddy_bytes() {
+    return BuddyBytes;
+}
+
+/**
+ * Return the free buddy block of the largest order (otherwise NULL if there
+ * are none).
+ **/
+Block * buddy_largest() {
+    for (size_t order = BUDDY_MAX_ORDER; BuddyEnabled && order >= BUDDY_MIN_ORDER; order--) {
+        Block *list = &BuddyLists[order - BUDDY_MIN_ORDER];
+        if (list->next != list) {
+            return list->next;
+        }
+    }
+
+    return NULL;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
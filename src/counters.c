@@ -1,10 +1,26 @@
 /* counters.c: Counters */
 
+#include "malloc/adaptive.h"
+#include "malloc/arena.h"
+#include "malloc/background.h"
 #include "malloc/block.h"
+#include "malloc/buddy.h"
 #include "malloc/counters.h"
+#include "malloc/exact.h"
+#include "malloc/fastbins.h"
 #include "malloc/freelist.h"
+#include "malloc/index.h"
+#include "malloc/maxheap.h"
+#include "malloc/pagemap.h"
+#include "malloc/percpu.h"
+#include "malloc/profile.h"
+#include "malloc/segment.h"
+#include "malloc/sites.h"
+#include "malloc/stats.h"
 
 #include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -22,6 +38,21 @@ int    DumpFD              = -1;
  *
  *  1. Register the dump_counters function to run when the program terminates.
  *  2. Duplicate standard output file descriptor to the DumpFD global variable.
+ *  3. Register the fork handlers of the arena lock.
+ *  4. Read the settings of the heap (huge pages, reservation and segments).
+ *  5. Enable the page map of the heap (if requested).
+ *  6. Read the tunables of the free list.
+ *  7. Publish the shared memory stats page (if requested).
+ *  8. Start the sampling heap profiler (if requested).
+ *  9. Enable per call site statistics (if requested).
+ * 10. Enable the fast bins (if requested).
+ * 11. Enable the exact fit index of the free list (if requested).
+ * 12. Enable the adaptive policy of the free list (if requested).
+ * 13. Start the background thread (if requested).
+ * 14. Map the per-CPU caches (if built with PERCPU).
+ * 15. Reserve the space of the buddy system (if built with BUDDY).
+ * 16. Map the capacity index (if built with SOA) or the max-heap (if built
+ *  with worst fit) of the free list.
  *
  * Note, these actions should only be performed once regardless of how many
  * times the function is called.
@@ -34,6 +65,28 @@ void init_counters() {
         initialized = true;
         DumpFD      = dup(STDOUT_FILENO);
         assert(DumpFD >= 0);
+        arena_init();
+        block_init();
+        pagemap_init();
+        free_list_init();
+        stats_init();
+        profile_init();
+        sites_init();
+        fastbins_init();
+        exact_init();
+        adaptive_init();
+        background_init();
+#if PERCPU
+        percpu_init();
+#endif
+#if BUDDY
+        buddy_init();
+#endif
+#if SOA
+        index_init();
+#elif defined FIT && FIT == 1
+        maxheap_init();
+#endif
     }
 }
 
@@ -45,8 +98,6 @@ void init_counters() {
  * @return  Percentage of internal fragmentation in heap.
  **/
 double  internal_fragmentation() {
-    // TODO: Implement internal fragmentation computation
-
     double internal_frags = 0;
     
     for (Block *curr = FreeList.next; curr != &FreeList; curr = curr->next) {
@@ -54,6 +105,7 @@ double  internal_fragmentation() {
         if(curr->capacity > curr->size)
             internal_frags += curr->capacity - curr->size;
     }
+    internal_frags += Counters[BUDDY_WASTE];
     
 
     if (!Counters[HEAP_SIZE]) {
@@ -70,13 +122,27 @@ double  internal_fragmentation() {
  *
  * https://www.edn.com/design/systems-design/4333346/Handling-memory-fragmentation
  *
+ * Note, when the free list is kept in a max-heap, both the largest free block
+ * and the free memory are read from it instead of scanning the free list.
+ * The free buddy blocks (if any) count as free memory as well.
+ *
  * @return  Percentage of external fragmentation in heap.
  **/
 double  external_fragmentation() {
-    // TODO: Implement external fragmentation computation
+    if (MaxHeapEnabled) {
+        Block *largest = maxheap_peek();
+        double counter = maxheap_bytes();
+
+        return counter ? (double) (1 - largest->capacity / counter) * 100.0 : 0;
+    }
 
     Block  *largest_fblock = FreeList.next;
-    double counter = 0;
+    Block  *largest_buddy  = buddy_largest();
+    double counter = buddy_bytes();
+
+    if (largest_buddy && (largest_fblock == &FreeList || largest_buddy->capacity > largest_fblock->capacity)) {
+        largest_fblock = largest_buddy;
+    }
 
     for (Block *curr = FreeList.next; curr != &FreeList; curr = curr->next) {
         if (curr->capacity > largest_fblock->capacity) {
@@ -92,6 +158,58 @@ double  external_fragmentation() {
     return  (double) (1 - largest_fblock->capacity / counter) * 100.0;
 }
 
+/**
+ * Compute huge page coverage of the heap using the formula:
+ *
+ *  COVERAGE = (HUGETLB + Sum(AnonHugePages in extents)) / (HUGETLB + EXTENTS) * 100.0
+ *
+ * where the AnonHugePages of the mappings overlapping the huge page extents
+ * are read from /proc/self/smaps.
+ *
+ * @return  Percentage of huge page backed heap.
+ **/
+double  huge_coverage() {
+    size_t total   = Counters[HUGE_HEAP] + Counters[HUGE_TLB];
+    size_t covered = Counters[HUGE_TLB];
+
+    if (!total) {
+        return 0;
+    }
+
+    int fd = open("/proc/self/smaps", O_RDONLY);
+    if (fd >= 0) {
+        char    buffer[BUFSIZ];
+        char    line[BUFSIZ];
+        size_t  length  = 0;
+        bool    extents = false;
+        ssize_t nread;
+
+        while ((nread = read(fd, buffer, BUFSIZ)) > 0) {
+            for (ssize_t i = 0; i < nread; i++) {
+                if (buffer[i] != '\n') {
+                    if (length < BUFSIZ - 1) {
+                        line[length++] = buffer[i];
+                    }
+                    continue;
+                }
+
+                unsigned long start, end, kilobytes;
+                line[length] = 0;
+                length       = 0;
+
+                if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+                    extents = start < (uintptr_t)HeapEnd && end > (uintptr_t)HeapStart;
+                } else if (extents && sscanf(line, "AnonHugePages: %lu kB", &kilobytes) == 1) {
+                    covered += kilobytes * 1024;
+                }
+            }
+        }
+        close(fd);
+    }
+
+    return (double)(covered < total ? covered : total) / total * 100.0;
+}
+
 /**
  * Display all counters to the DumpFD global file descriptor saved in
  * init_counters.
@@ -103,6 +221,16 @@ void dump_counters() {
     char buffer[BUFSIZ];
     assert(DumpFD >= 0);
 
+    // Keep the background thread out of the heap for the rest of the exit
+    if (BackgroundEnabled) {
+        arena_lock(&MainArena);
+    }
+
+    // Count the mallocs and frees that the per-CPU caches served
+    if (PerCpuEnabled) {
+        percpu_collect();
+    }
+
     fdprintf(DumpFD, buffer, "blocks:      %lu\n"   , Counters[BLOCKS]);
     fdprintf(DumpFD, buffer, "free blocks: %lu\n"   , free_list_length());
     fdprintf(DumpFD, buffer, "mallocs:     %lu\n"   , Counters[MALLOCS]);
@@ -119,6 +247,90 @@ void dump_counters() {
     fdprintf(DumpFD, buffer, "internal:    %4.2lf\n", internal_fragmentation());
     fdprintf(DumpFD, buffer, "external:    %4.2lf\n", external_fragmentation());
 
+    if (HugePages || HugeTLB) {
+        fdprintf(DumpFD, buffer, "huge heap:   %lu\n"   , Counters[HUGE_HEAP]);
+        fdprintf(DumpFD, buffer, "huge tlb:    %lu\n"   , Counters[HUGE_TLB]);
+        fdprintf(DumpFD, buffer, "huge pages:  %4.2lf\n", huge_coverage());
+    }
+
+    if (Reserved) {
+        fdprintf(DumpFD, buffer, "committed:   %lu\n"   , Counters[COMMITTED]);
+        fdprintf(DumpFD, buffer, "decommitted: %lu\n"   , Counters[DECOMMITTED]);
+    }
+
+    if (SegmentsEnabled) {
+        fdprintf(DumpFD, buffer, "segments:    %lu\n"   , segment_count());
+        fdprintf(DumpFD, buffer, "seg maps:    %lu\n"   , Counters[SEGMENT_MAPS]);
+        fdprintf(DumpFD, buffer, "seg unmaps:  %lu\n"   , Counters[SEGMENT_UNMAPS]);
+        fdprintf(DumpFD, buffer, "seg bytes:   %lu\n"   , Counters[SEGMENT_BYTES]);
+    }
+
+    if (BuddyEnabled) {
+        fdprintf(DumpFD, buffer, "buddy waste: %lu\n"   , Counters[BUDDY_WASTE]);
+    }
+
+    if (PageMapEnabled) {
+        fdprintf(DumpFD, buffer, "pagemap:     %lu\n"   , Counters[PAGEMAP_BYTES]);
+        fdprintf(DumpFD, buffer, "foreign:     %lu\n"   , Counters[FOREIGN_POINTERS]);
+    }
+
+    if (Counters[REMAPS]) {
+        fdprintf(DumpFD, buffer, "remaps:      %lu\n"   , Counters[REMAPS]);
+        fdprintf(DumpFD, buffer, "remapped:    %lu\n"   , Counters[REMAPPED]);
+    }
+
+    if (Counters[REMOTE_FREES]) {
+        fdprintf(DumpFD, buffer, "remote:      %lu\n"   , Counters[REMOTE_FREES]);
+        fdprintf(DumpFD, buffer, "drains:      %lu\n"   , Counters[DRAINS]);
+        fdprintf(DumpFD, buffer, "drain avg:   %4.2lf\n", Counters[DRAINS] ? (double)Counters[DRAINED] / Counters[DRAINS] : 0);
+        fdprintf(DumpFD, buffer, "drain max:   %lu\n"   , Counters[DRAIN_MAX]);
+    }
+
+    if (Counters[BULK_MALLOCS] || Counters[BULK_FREES]) {
+        fdprintf(DumpFD, buffer, "bulk mallocs: %lu\n"  , Counters[BULK_MALLOCS]);
+        fdprintf(DumpFD, buffer, "bulk frees:   %lu\n"  , Counters[BULK_FREES]);
+        fdprintf(DumpFD, buffer, "bulk runs:    %lu\n"  , Counters[BULK_RUNS]);
+    }
+
+    if (Counters[REGION_CHUNKS]) {
+        fdprintf(DumpFD, buffer, "region allocs: %lu\n" , Counters[REGION_ALLOCS]);
+        fdprintf(DumpFD, buffer, "region bytes:  %lu\n" , Counters[REGION_BYTES]);
+        fdprintf(DumpFD, buffer, "region chunks: %lu\n" , Counters[REGION_CHUNKS]);
+        fdprintf(DumpFD, buffer, "region resets: %lu\n" , Counters[REGION_RESETS]);
+    }
+
+    if (FastBinsEnabled) {
+        fdprintf(DumpFD, buffer, "fast frees:  %lu\n"   , Counters[FAST_FREES]);
+        fdprintf(DumpFD, buffer, "fast reuses: %lu\n"   , Counters[FAST_REUSES]);
+        fdprintf(DumpFD, buffer, "consolidates: %lu\n"  , Counters[CONSOLIDATES]);
+    }
+
+    if (ExactEnabled) {
+        fdprintf(DumpFD, buffer, "exact hits:  %lu\n"   , Counters[EXACT_HITS]);
+        fdprintf(DumpFD, buffer, "exact misses: %lu\n"  , Counters[EXACT_MISSES]);
+    }
+
+    if (AdaptiveEnabled) {
+        fdprintf(DumpFD, buffer, "policy:      %s\n"    , adaptive_name(AdaptivePolicy));
+        fdprintf(DumpFD, buffer, "switches:    %lu\n"   , Counters[POLICY_SWITCHES]);
+        fdprintf(DumpFD, buffer, "search avg:  %4.2lf\n", Counters[SEARCHES] ? (double)Counters[SEARCH_STEPS] / Counters[SEARCHES] : 0);
+    }
+
+    if (BackgroundEnabled) {
+        fdprintf(DumpFD, buffer, "bg runs:     %lu\n"   , Counters[BACKGROUND_RUNS]);
+        fdprintf(DumpFD, buffer, "bg cpu ms:   %4.2lf\n", Counters[BACKGROUND_NS] / 1000000.0);
+        fdprintf(DumpFD, buffer, "purged:      %lu\n"   , Counters[PURGED]);
+        fdprintf(DumpFD, buffer, "prefaulted:  %lu\n"   , Counters[PREFAULTED]);
+    }
+
+    if (PerCpuEnabled) {
+        percpu_dump(DumpFD);
+    }
+
+    if (SitesEnabled) {
+        sites_dump(DumpFD);
+    }
+
     close(DumpFD);
 }
 
@@ -0,0 +1,163 @@
+/* exact.c: Exact Fit Index
+ *
+ * When EXACT_ENV is set, every free block in the free list is also pushed
+ * onto a stack kept for its capacity, so that a request whose aligned size
+ * matches the capacity of a free block gets that block back without a scan of
+ * the free list (and without a split).  Stacks are LIFO, so the block freed
+ * last (and most likely still in the cache) is reused first.
+ *
+ * The stacks live in a hash table of {capacity, head} entries with open
+ * addressing: a capacity is hashed to a bucket and takes the first entry of
+ * the EXACT_PROBES buckets from there that is unused or whose stack is empty.
+ * A lookup thus compares at most EXACT_PROBES capacities and pops the head of
+ * the matching stack, however many blocks of other capacities are free.  A
+ * block whose buckets are all taken by stacks of other capacities is simply
+ * not indexed (and left to the policy).
+ *
+ * Each stack is a list linked through the free blocks themselves (past the
+ * index slot), where every block keeps a pointer to whatever points to it so
+ * that it can be removed in O(1) after a merge or a split.  Blocks smaller
+ * than EXACT_MIN have no room for the links and are left to the policy.
+ *
+ * On a miss, free_list_search falls back to the policy it was built with.
+ **/
+
+#include "malloc/counters.h"
+#include "malloc/exact.h"
+
+/* Global Variables */
+
+bool                ExactEnabled = false;
+static ExactEntry   ExactBuckets[EXACT_BUCKETS];
+
+/* Functions */
+
+/**
+ * Hash the specified capacity to its first bucket (Fibonacci hashing).
+ * @param   capacity    Aligned capacity of block.
+ * @return  Number of first bucket to probe.
+ **/
+static inline size_t exact_hash(size_t capacity) {
+    return ((capacity / ALIGNMENT) * 0x9E3779B97F4A7C15UL) >> (64 - EXACT_BITS);
+}
+
+/**
+ * Find the entry for the specified capacity.
+ *
+ * Note, entries are only ever taken in probe order and never given back, so
+ * the probe can stop at the first unused bucket.
+ *
+ * @param   capacity    Aligned capacity of block.
+ * @return  Pointer to entry (otherwise NULL if there is none).
+ **/
+static inline ExactEntry *exact_find(size_t capacity) {
+    size_t bucket = exact_hash(capacity);
+
+    for (size_t probe = 0; probe < EXACT_PROBES; probe++) {
+        ExactEntry *entry = &ExactBuckets[(bucket + probe) & (EXACT_BUCKETS - 1)];
+        if (entry->capacity == capacity) {
+            return entry;
+        }
+        if (!entry->capacity) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Enable the exact fit index if the EXACT_ENV environment variable is set to
+ * a nonzero number.
+ *
+ * Note, this should only be called once (from init_counters) before any block
+ * is inserted into the free list.
+ **/
+void    exact_init() {
+    char *exact = getenv(EXACT_ENV);
+    if (!exact || !atoi(exact)) {
+        return;
+    }
+
+    ExactEnabled = true;
+}
+
+/**
+ * Push a block that was added to the free list onto the stack for its
+ * capacity (taking an unused or empty entry for it if there is none).
+ * @param   block   Pointer to free block.
+ **/
+void    exact_insert(Block *block) {
+    if (block->capacity < EXACT_MIN) {
+        return;
+    }
+
+    ExactLink * link   = EXACT_LINK(block);
+    ExactEntry *entry  = exact_find(block->capacity);
+    size_t      bucket = exact_hash(block->capacity);
+
+    for (size_t probe = 0; !entry && probe < EXACT_PROBES; probe++) {
+        ExactEntry *curr = &ExactBuckets[(bucket + probe) & (EXACT_BUCKETS - 1)];
+        if (!curr->head) {
+            entry = curr;
+            entry->capacity = block->capacity;
+        }
+    }
+
+    if (!entry) {
+        link->pprev = NULL;
+        return;
+    }
+
+    link->next  = entry->head;
+    link->pprev = &entry->head;
+    if (entry->head) {
+        EXACT_LINK(entry->head)->pprev = &link->next;
+    }
+    entry->head = block;
+}
+
+/**
+ * Remove a block that left the free list (or changed capacity) from its
+ * stack.
+ * @param   block       Pointer to free block.
+ * @param   capacity    Capacity of the block when it was inserted.
+ **/
+void    exact_remove(Block *block, size_t capacity) {
+    if (capacity < EXACT_MIN) {
+        return;
+    }
+
+    ExactLink *link = EXACT_LINK(block);
+    if (!link->pprev) {
+        return;
+    }
+
+    *link->pprev = link->next;
+    if (link->next) {
+        EXACT_LINK(link->next)->pprev = link->pprev;
+    }
+}
+
+/**
+ * Search for the free block that was inserted last with exactly the capacity
+ * the specified size rounds up to.
+ * @param   size    Amount of memory required.
+ * @return  Pointer to existing block (otherwise NULL if none are available).
+ **/
+Block * exact_search(size_t size) {
+    size_t capacity = ALIGN(size);
+    if (capacity < EXACT_MIN) {
+        return NULL;
+    }
+
+    ExactEntry *entry = exact_find(capacity);
+    if (!entry || !entry->head) {
+        return NULL;
+    }
+
+    entry->head->size = size;
+    return entry->head;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
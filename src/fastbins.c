@@ -0,0 +1,167 @@
+/* fastbins.c: Fast Bins
+ *
+ * When FASTBINS_ENV is set, freed blocks with at most that capacity are not
+ * merged into the free list right away.  Instead, they are pushed onto a LIFO
+ * bin for their exact capacity (linked through next), so that a program that
+ * keeps freeing and allocating the same size reuses the block without a merge
+ * followed by a split.
+ *
+ * The bins are consolidated (every block is released or inserted into the
+ * free list, merging as usual) when a request misses the free list or when
+ * the bins hold more than FASTBINS_THRESHOLD bytes.
+ *
+ * Blocks of the buddy system are left out, since they merge in constant time
+ * already (and keep the size they were taken with, see buddy_take).
+ **/
+
+#include "malloc/buddy.h"
+#include "malloc/counters.h"
+#include "malloc/fastbins.h"
+#include "malloc/freelist.h"
+
+/* Global Variables */
+
+bool            FastBinsEnabled = false;
+static size_t   FastBinsMax     = 0;            /* Largest binned capacity */
+static size_t   FastBinsCount   = 0;            /* Number of binned blocks */
+static size_t   FastBinsBytes   = 0;            /* Capacity of binned blocks */
+static Block *  FastBins[FASTBINS];
+
+/* Functions */
+
+/**
+ * Enable fast bins if the FASTBINS_ENV environment variable is set to a
+ * positive capacity (clamped to FASTBINS_MAX).
+ *
+ * Note, this should only be called once (from init_counters).
+ **/
+void    fastbins_init() {
+    char *max = getenv(FASTBINS_ENV);
+    if (!max || atol(max) <= 0) {
+        return;
+    }
+
+    FastBinsMax     = atol(max) < FASTBINS_MAX ? ALIGN((size_t)atol(max)) : FASTBINS_MAX;
+    FastBinsEnabled = true;
+}
+
+/**
+ * Push the specified freed block onto the bin for its capacity.
+ *
+ * Note, this requires the MainArena lock.
+ *
+ * @param   block   Pointer to block being freed.
+ * @return  Whether or not the block was binned.
+ **/
+bool    fastbins_push(Block *block) {
+    if (!FastBinsEnabled || block->capacity > FastBinsMax || buddy_owns(block)) {
+        return false;
+    }
+
+    size_t bin = block->capacity / ALIGNMENT - 1;
+
+    block->next    = FastBins[bin];
+    FastBins[bin]  = block;
+    FastBinsCount++;
+    FastBinsBytes += block->capacity;
+    Counters[FAST_FREES]++;
+
+    if (FastBinsBytes > FASTBINS_THRESHOLD) {
+        fastbins_consolidate();
+    }
+    return true;
+}
+
+/**
+ * Pop a block with exactly the capacity the specified size rounds up to.
+ *
+ * Note, this requires the MainArena lock.
+ *
+ * @param   size    Amount of memory required.
+ * @return  Pointer to detached block (otherwise NULL if the bin is empty).
+ **/
+Block * fastbins_pop(size_t size) {
+    if (!FastBinsEnabled || !size || ALIGN(size) > FastBinsMax) {
+        return NULL;
+    }
+
+    size_t bin   = ALIGN(size) / ALIGNMENT - 1;
+    Block *block = FastBins[bin];
+    if (!block) {
+        return NULL;
+    }
+
+    FastBins[bin]  = block->next;
+    FastBinsCount--;
+    FastBinsBytes -= block->capacity;
+    block->next    = block;
+    block->size    = size;
+
+    Counters[REUSES]++;
+    Counters[FAST_REUSES]++;
+    return block;
+}
+
+/**
+ * Release or insert every binned block into the free list (merging them with
+ * their neighbors).
+ *
+ * Note, this requires the MainArena lock.
+ *
+ * @return  Number of blocks consolidated.
+ **/
+size_t  fastbins_consolidate() {
+    size_t count = 0;
+
+    if (!FastBinsBytes) {
+        return 0;
+    }
+
+    for (size_t bin = 0; bin < FASTBINS; bin++) {
+        while (FastBins[bin]) {
+            Block *block  = FastBins[bin];
+            FastBins[bin] = block->next;
+            block->next   = block;
+            count++;
+
+            if (!block_release(block)) {
+                free_list_insert(block);
+            }
+        }
+    }
+
+    FastBinsCount = 0;
+    FastBinsBytes = 0;
+    Counters[CONSOLIDATES]++;
+    return count;
+}
+
+/**
+ * Return the number of binned blocks.
+ **/
+size_t  fastbins_length() {
+    return FastBinsCount;
+}
+
+/**
+ * Return the capacity of all the binned blocks.
+ **/
+size_t  fastbins_bytes() {
+    return FastBinsBytes;
+}
+
+/**
+ * Return a binned block of the largest capacity (otherwise NULL if the bins
+ * are empty).
+ **/
+Block * fastbins_largest() {
+    for (size_t bin = FASTBINS; FastBinsCount && bin > 0; bin--) {
+        if (FastBins[bin - 1]) {
+            return FastBins[bin - 1];
+        }
+    }
+
+    return NULL;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
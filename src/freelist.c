@@ -3,17 +3,156 @@
  * The FreeList is an unordered doubly-linked circular list containing all the
  * available memory allocations (memory that has been previous allocated and
  * can be re-used).
+ *
+ * With the address-ordered policy (FIT 3), the FreeList is instead kept
+ * sorted by address and indexed by a skip list, so that a block can be placed
+ * (and merged with both of its neighbors) in O(log n).
+ *
+ * When built with SOA, the capacities of the blocks in the FreeList are also
+ * kept in a dense index that best and worst fit scan with SIMD instead.
+ * Otherwise, worst fit keeps them in a max-heap and simply peeks at its root.
+ *
+ * The good fit policy (FIT 4) scans like best fit, but stops at the first
+ * block within GoodFitSlack percent of the request (or after trying
+ * GoodFitCandidates blocks that fit) and takes the best block seen so far.
+ *
+ * When built with BUDDY, blocks that fit in a buddy chunk are handed to the
+ * buddy system instead, and only larger blocks are kept in the FreeList.
+ *
+ * With HOT_REUSE_ENV set, freed blocks are put at the front of the FreeList
+ * instead of the end, so that the policies find the most recently freed (and
+ * most likely cached) memory first.
+ *
+ * With EXACT_ENV set, the blocks are also hashed by capacity, so that a block
+ * that fits a request exactly is found before any of the policies run.
+ *
+ * With ADAPTIVE_ENV set, the policy is instead chosen (and changed) at run
+ * time by the adaptive policy (see adaptive.c), which samples the FREE_BYTES
+ * kept here and the number of blocks the searches visit.
+ *
+ * When the heap is made of segments, the bytes of the blocks that enter and
+ * leave the FreeList are added to (and subtracted from) their segment, so
+ * that a segment whose blocks are all free can be unmapped.
  **/
 
+#include "malloc/adaptive.h"
+#include "malloc/buddy.h"
 #include "malloc/counters.h"
+#include "malloc/exact.h"
 #include "malloc/freelist.h"
+#include "malloc/index.h"
+#include "malloc/maxheap.h"
+#include "malloc/segment.h"
+#include "malloc/skiplist.h"
+
+#include <string.h>
 
 /* Global Variables */
 
 Block FreeList = {-1, -1, &FreeList, &FreeList};
+bool  HotReuse = false;
+
+size_t GoodFitSlack      = GOODFIT_SLACK;
+size_t GoodFitCandidates = GOODFIT_CANDIDATES;
 
 /* Functions */
 
+/**
+ * Read the tunables of the free list:
+ *
+ *  - HOT_REUSE_ENV:            Put freed blocks at the front of the free list
+ *                              (ignored by the address-ordered policy).
+ *  - GOODFIT_SLACK_ENV:        Percentage of the request a block may waste
+ *                              and still end the search (at most
+ *                              GOODFIT_SLACK_MAX).
+ *  - GOODFIT_CANDIDATES_ENV:   Number of fitting blocks to try before taking
+ *                              the best one seen (at least 1).
+ *
+ * Note, this should only be called once (from init_counters).
+ **/
+void    free_list_init() {
+    char *slack      = getenv(GOODFIT_SLACK_ENV);
+    char *candidates = getenv(GOODFIT_CANDIDATES_ENV);
+    char *hot_reuse  = getenv(HOT_REUSE_ENV);
+
+    HotReuse = hot_reuse && *hot_reuse && strcmp(hot_reuse, "0");
+
+    if (slack && *slack && atol(slack) >= 0) {
+        GoodFitSlack = atol(slack) < GOODFIT_SLACK_MAX ? atol(slack) : GOODFIT_SLACK_MAX;
+    }
+    if (candidates && atol(candidates) > 0) {
+        GoodFitCandidates = atol(candidates);
+    }
+}
+
+/**
+ * Add a block appended to the free list to the index of the policy (if any).
+ **/
+static inline void free_list_index_insert(Block *block) {
+#if     defined SOA && SOA
+    index_insert(block);
+#elif   defined FIT && FIT == 1
+    maxheap_insert(block);
+#endif
+}
+
+/**
+ * Remove a block taken out of the free list from the index of the policy.
+ **/
+static inline void free_list_index_remove(Block *block) {
+#if     defined SOA && SOA
+    index_remove(block);
+#elif   defined FIT && FIT == 1
+    maxheap_remove(block);
+#elif   defined FIT && FIT == 3
+    skiplist_remove(block);
+#endif
+}
+
+/**
+ * Give the place of a block in the index of the policy to the block that took
+ * its place in the free list.
+ **/
+static inline void free_list_index_replace(Block *old_block, Block *new_block) {
+#if     defined SOA && SOA
+    index_replace(old_block, new_block);
+#elif   defined FIT && FIT == 1
+    maxheap_replace(old_block, new_block);
+#elif   defined FIT && FIT == 3
+    skiplist_replace(old_block, new_block);
+#endif
+}
+
+/**
+ * Update the capacity of a block in the index of the policy.
+ **/
+static inline void free_list_index_update(Block *block) {
+#if     defined SOA && SOA
+    index_update(block);
+#elif   defined FIT && FIT == 1
+    maxheap_update(block);
+#endif
+}
+
+/**
+ * Move a block out of the exact fit index (by the capacity it was inserted
+ * with) and another block (or the same one with a new capacity) into it.
+ * @param   old_block   Pointer to block leaving the index (or NULL).
+ * @param   capacity    Capacity of the old block when it was inserted.
+ * @param   new_block   Pointer to block entering the index (or NULL).
+ **/
+static inline void free_list_exact_update(Block *old_block, size_t capacity, Block *new_block) {
+    if (!ExactEnabled) {
+        return;
+    }
+    if (old_block) {
+        exact_remove(old_block, capacity);
+    }
+    if (new_block) {
+        exact_insert(new_block);
+    }
+}
+
 /**
  * Search for an existing block in free list with at least the specified size
  * using the first fit algorithm.
@@ -21,16 +160,19 @@ Block FreeList = {-1, -1, &FreeList, &FreeList};
  * @return  Pointer to existing block (otherwise NULL if none are available).
  **/
 Block * free_list_search_ff(size_t size) {
-    // TODO: Implement first fit algorithm
+    size_t steps = 0;
 
     for (Block *curr = FreeList.next; curr != &FreeList; curr = curr->next) {
+        steps++;
 
         if (curr->capacity >= size) {
+            Counters[SEARCH_STEPS] += steps;
             curr->size = size;
             return  curr;
         }
     }
 
+    Counters[SEARCH_STEPS] += steps;
     return NULL;
 
 }
@@ -42,12 +184,12 @@ Block * free_list_search_ff(size_t size) {
  * @return  Pointer to existing block (otherwise NULL if none are available).
  **/
 Block * free_list_search_bf(size_t size) {
-    // TODO: Implement best fit algorithm
-
     Block *smallest = NULL;
+    size_t steps    = 0;
 
     for (Block *curr = FreeList.next; curr != &FreeList; curr = curr->next) {
-        
+        steps++;
+
         if (curr->capacity >=  size && !smallest) {
             smallest = curr;
         }
@@ -57,6 +199,8 @@ Block * free_list_search_bf(size_t size) {
         }
     }
     
+    Counters[SEARCH_STEPS] += steps;
+
     if(smallest)
         smallest->size = size;
 
@@ -70,10 +214,11 @@ Block * free_list_search_bf(size_t size) {
  * @return  Pointer to existing block (otherwise NULL if none are available).
  **/
 Block * free_list_search_wf(size_t size) {
-    // TODO: Implement worst fit algorithm
     Block *largest = NULL;
+    size_t steps   = 0;
 
     for (Block *curr = FreeList.next; curr != &FreeList; curr = curr->next) {
+        steps++;
 
         if (curr->capacity >= size && !largest) {
             largest = curr;
@@ -84,30 +229,121 @@ Block * free_list_search_wf(size_t size) {
         }
     }
 
+    Counters[SEARCH_STEPS] += steps;
+
     if(largest)
         largest->size = size;
 
     return  largest;
 }
 
+/**
+ * Search for an existing block in free list with at least the specified size
+ * using the good fit algorithm: keep the smallest fitting block seen, but
+ * stop as soon as it is good enough (wastes at most GoodFitSlack percent of
+ * the size) or GoodFitCandidates fitting blocks have been seen.
+ * @param   size    Amount of memory required.
+ * @return  Pointer to existing block (otherwise NULL if none are available).
+ **/
+Block * free_list_search_gf(size_t size) {
+    Block *best       = NULL;
+    size_t candidates = 0;
+    size_t steps      = 0;
+    size_t good       = size / 100 * GoodFitSlack + size % 100 * GoodFitSlack / 100;
+
+    for (Block *curr = FreeList.next; curr != &FreeList; curr = curr->next) {
+        steps++;
+        if (curr->capacity < size) {
+            continue;
+        }
+
+        if (!best || curr->capacity < best->capacity) {
+            best = curr;
+        }
+
+        if (best->capacity - size <= good || ++candidates >= GoodFitCandidates) {
+            break;
+        }
+    }
+
+    Counters[SEARCH_STEPS] += steps;
+
+    if (best) {
+        best->size = size;
+    }
+    return best;
+}
+
+/**
+ * Search for an existing block in free list with at least the specified size
+ * using the policy chosen by the adaptive policy (which gets to sample the
+ * searches first).
+ * @param   size    Amount of memory required.
+ * @return  Pointer to existing block (otherwise NULL if none are available).
+ **/
+static Block *free_list_search_adaptive(size_t size) {
+    adaptive_sample();
+
+    switch (AdaptivePolicy) {
+        case ADAPTIVE_GF: return free_list_search_gf(size);
+        case ADAPTIVE_BF: return free_list_search_bf(size);
+        default:          return free_list_search_ff(size);
+    }
+}
+
 /**
  * Search for an existing block in free list with at least the specified size.
  *
- * Note, this is a wrapper function that calls one of the three algorithms
- * above based on the compile-time setting.
+ * Note, this is a wrapper function that calls one of the four algorithms
+ * above based on the compile-time setting (or the adaptive policy, if
+ * enabled) after trying the exact fit index (if enabled), unless the buddy
+ * system serves the size.
  *
  * @param   size    Amount of memory required.
  * @return  Pointer to existing block (otherwise NULL if none are available).
  **/
 Block * free_list_search(size_t size) {
     Block * block = NULL;
+
+    if (BuddyEnabled && size <= BUDDY_MAX_CAPACITY) {
+        return buddy_search(size);
+    }
+
+    if (ExactEnabled) {
+        block = exact_search(size);
+        if (block) {
+            Counters[EXACT_HITS]++;
+            Counters[REUSES]++;
+            return block;
+        }
+        Counters[EXACT_MISSES]++;
+    }
+
+    Counters[SEARCHES]++;
+
+    if (AdaptiveEnabled) {
+        block = free_list_search_adaptive(size);
+    } else {
 #if     defined FIT && FIT == 0
-    block = free_list_search_ff(size);
+        block = free_list_search_ff(size);
 #elif   defined FIT && FIT == 1
-    block = free_list_search_wf(size);
+#if     defined SOA && SOA
+        block = IndexEnabled ? index_search_wf(size) : free_list_search_wf(size);
+#else
+        block = MaxHeapEnabled ? maxheap_search(size) : free_list_search_wf(size);
+#endif
 #elif   defined FIT && FIT == 2
-    block = free_list_search_bf(size);
+#if     defined SOA && SOA
+        block = IndexEnabled ? index_search_bf(size) : free_list_search_bf(size);
+#else
+        block = free_list_search_bf(size);
 #endif
+#elif   defined FIT && FIT == 3
+        block = free_list_search_ff(size);
+#elif   defined FIT && FIT == 4
+        block = free_list_search_gf(size);
+#endif
+    }
 
     if (block) {
         Counters[REUSES]++;
@@ -115,6 +351,64 @@ Block * free_list_search(size_t size) {
     return block;
 }
 
+/**
+ * Insert specified block into free list sorted by address:
+ *
+ *  1. Find the free blocks right before and after it with the skip list.
+ *  2. Merge the block into the previous block (and then the next block into
+ *  that one) if they are adjacent.
+ *  3. Otherwise, merge the next block into it if they are adjacent.
+ *  4. Otherwise, link the block between the two.
+ *
+ * @param   block   Pointer to block to insert into free list.
+ **/
+void    free_list_insert_ao(Block *block) {
+    Block *prev = skiplist_lower(block);
+    if (!prev) {
+        prev = &FreeList;
+    }
+    Block *next = prev->next;
+
+    size_t capacity = prev->capacity;
+    if (prev != &FreeList && block_merge(prev, block)) {
+        if (next != &FreeList && block_merge(prev, next)) {
+            skiplist_remove(next);
+            free_list_exact_update(next, next->capacity, NULL);
+            block_detach(next);
+        }
+        free_list_exact_update(prev, capacity, prev);
+        return;
+    }
+
+    if (next != &FreeList && block_merge(block, next)) {
+        skiplist_replace(next, block);
+        free_list_exact_update(next, next->capacity, block);
+        next = next->next;
+    } else {
+        skiplist_insert(block);
+        free_list_exact_update(NULL, 0, block);
+    }
+
+    block->prev = prev;
+    block->next = next;
+    prev->next  = block;
+    next->prev  = block;
+}
+
+/**
+ * Move a block in the free list to the front.
+ * @param   block   Pointer to block in free list.
+ **/
+static inline void free_list_front(Block *block) {
+    block->prev->next = block->next;
+    block->next->prev = block->prev;
+
+    block->prev = &FreeList;
+    block->next = FreeList.next;
+    FreeList.next->prev = block;
+    FreeList.next       = block;
+}
+
 /**
  * Insert specified block into free list.
  *
@@ -123,14 +417,17 @@ Block * free_list_search(size_t size) {
  * appropriately).
  *
  * If a merge is not possible, then simply add the block to the end of the free
- * list.
+ * list (or the front with HotReuse, which also moves a block that absorbed the
+ * next block to the front, since it starts with the memory just freed).
  * @param   block   Pointer to block to insert into free list.
  **/
-void    free_list_insert(Block *block) {
-    // TODO: Implement free list insertion
-
+void    free_list_insert_unordered(Block *block) {
     for (Block *curr = FreeList.next; curr != &FreeList; curr = curr->next) {
+        size_t capacity = curr->capacity;
+
         if (block_merge(block, curr)) {
+            free_list_index_replace(curr, block);
+            free_list_exact_update(curr, capacity, block);
 
             block->prev = curr->prev;
             block->next = curr->next;
@@ -138,36 +435,101 @@ void    free_list_insert(Block *block) {
             curr->prev->next = block;
             curr->next->prev = block;
 
+            if (HotReuse) {
+                free_list_front(block);
+            }
             return;
         }
 
-        if (block_merge(curr, block)) return;
+        if (block_merge(curr, block)) {
+            free_list_index_update(curr);
+            free_list_exact_update(curr, capacity, curr);
+            return;
+        }
+    }
+
+    // Add block to the end of the free list (or the front for hot reuse)
+    Block *prev = HotReuse ? &FreeList : FreeList.prev;
+    Block *next = prev->next;
+
+    prev->next = block;
+    next->prev = block;
+
+    block->next = next;
+    block->prev = prev;
+    free_list_index_insert(block);
+    free_list_exact_update(NULL, 0, block);
+}
+
+/**
+ * Insert specified block into the buddy system (if it owns the block) or the
+ * free list of the policy, adding its bytes to FREE_BYTES and its segment (if
+ * any).
+ * @param   block   Pointer to block to insert into free list.
+ **/
+void    free_list_insert(Block *block) {
+    if (buddy_owns(block)) {
+        buddy_insert(block);
+        return;
+    }
+
+    Segment *segment = SegmentsEnabled ? segment_find(block) : NULL;
+    size_t   bytes   = sizeof(Block) + block->capacity;
+
+#if     defined FIT && FIT == 3
+    free_list_insert_ao(block);
+#else
+    free_list_insert_unordered(block);
+#endif
+
+    Counters[FREE_BYTES] += bytes;
+    segment_free(segment, bytes);
+}
+
+/**
+ * Take a block returned by free_list_search out of the free list, leaving
+ * whatever it does not need for the specified size in its place.
+ * @param   block   Pointer to block in free list.
+ * @param   size    Amount of memory required.
+ * @return  Pointer to detached block.
+ **/
+Block * free_list_take(Block *block, size_t size) {
+    if (buddy_owns(block)) {
+        return buddy_take(block, size);
     }
 
-    // Add block to the end of the free list
-    Block *tail = FreeList.prev;
+    Block *next = block->next;
 
-    tail->next = block;
-    FreeList.prev = block;
+    // The header of the rest of the block may overwrite the exact fit links
+    free_list_exact_update(block, block->capacity, NULL);
 
-    block->next = &FreeList;
-    block->prev = tail;
+    block = block_split(block, size);
+    if (block->next != next) {
+        free_list_index_replace(block, block->next);
+        free_list_exact_update(NULL, 0, block->next);
+    } else {
+        free_list_index_remove(block);
+    }
+
+    Counters[FREE_BYTES] -= sizeof(Block) + block->capacity;
+    if (SegmentsEnabled) {
+        segment_take(block);
+    }
+    return block_detach(block);
 }
 
 /**
- * Return length of free list.
+ * Return length of free list (including the free buddy blocks).
  * @return  Length of the free list.
  **/
 size_t  free_list_length() {
-    // TODO: Implement free list length
-
     size_t counter = 0;
 
     for (Block *curr = FreeList.next; curr != &FreeList; curr = curr->next) {
         counter++;
     }
 
-    return counter;
+    return counter + buddy_length();
 }
 
 /* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
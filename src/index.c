@@ -0,0 +1,329 @@
+/* index.c: Capacity Index
+ *
+ * When the library is built with SOA, the capacities of the blocks in the
+ * free list are also kept in a dense array (parallel to an array of the block
+ * pointers), so that best and worst fit can scan contiguous memory with SIMD
+ * compare and min/max kernels instead of chasing next pointers through cold
+ * block headers.
+ *
+ * Each free block stores its slot in the first word of its data (which is
+ * unused while the block is free), so that it can be removed in O(1) by
+ * moving the last slot into its place.
+ *
+ * The kernel (AVX2, SSE4.2, or scalar) is selected once by CPUID when the
+ * index is initialized.
+ **/
+
+#define _GNU_SOURCE     /* For mremap */
+
+#include "malloc/index.h"
+
+#include <immintrin.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/* Global Variables */
+
+bool            IndexEnabled = false;
+const char *    IndexKernel  = "none";
+
+static size_t * IndexCapacities = NULL;
+static Block ** IndexBlocks     = NULL;
+static size_t   IndexCount      = 0;
+static size_t   IndexSlots      = 0;
+static size_t   (*IndexSearch)(const size_t *, size_t, size_t, bool) = NULL;
+
+/* Functions */
+
+/**
+ * Pick the better of two candidate slots (ties go to the lower slot).
+ * @param   best        Whether to pick the smallest (otherwise the largest)
+ * capacity.
+ **/
+static inline bool index_better(size_t capacity, size_t slot, size_t best_capacity, size_t best_slot, bool best) {
+    if (best_slot == SIZE_MAX) {
+        return true;
+    }
+
+    if (capacity == best_capacity) {
+        return slot < best_slot;
+    }
+
+    return best ? capacity < best_capacity : capacity > best_capacity;
+}
+
+/**
+ * Find the slot with the smallest (or largest) capacity that fits the
+ * specified size one slot at a time.
+ * @param   capacities  Array of capacities.
+ * @param   n           Number of slots.
+ * @param   size        Amount of memory required.
+ * @param   best        Whether to pick the smallest (otherwise the largest)
+ * capacity.
+ * @return  Slot (otherwise SIZE_MAX if no capacity fits).
+ **/
+static size_t index_search_scalar(const size_t *capacities, size_t n, size_t size, bool best) {
+    size_t best_slot     = SIZE_MAX;
+    size_t best_capacity = 0;
+
+    for (size_t slot = 0; slot < n; slot++) {
+        if (capacities[slot] >= size && index_better(capacities[slot], slot, best_capacity, best_slot, best)) {
+            best_slot     = slot;
+            best_capacity = capacities[slot];
+        }
+    }
+
+    return best_slot;
+}
+
+/**
+ * Reduce the per-lane candidates of a SIMD kernel and scan the remaining
+ * slots that did not fill a vector.
+ **/
+static size_t index_reduce(const int64_t *lane_capacities, const int64_t *lane_slots, int lanes,
+                           const size_t *capacities, size_t start, size_t n, size_t size, bool best) {
+    size_t best_slot     = SIZE_MAX;
+    size_t best_capacity = 0;
+
+    for (int lane = 0; lane < lanes; lane++) {
+        if (lane_slots[lane] >= 0 && index_better(lane_capacities[lane], lane_slots[lane], best_capacity, best_slot, best)) {
+            best_slot     = lane_slots[lane];
+            best_capacity = lane_capacities[lane];
+        }
+    }
+
+    for (size_t slot = start; slot < n; slot++) {
+        if (capacities[slot] >= size && index_better(capacities[slot], slot, best_capacity, best_slot, best)) {
+            best_slot     = slot;
+            best_capacity = capacities[slot];
+        }
+    }
+
+    return best_slot;
+}
+
+/**
+ * Find the slot with the smallest (or largest) capacity that fits the
+ * specified size two slots at a time with SSE4.2.
+ *
+ * Note, capacities are compared as signed 64-bit integers (they never reach
+ * 2^63), and each lane keeps its first candidate on ties.
+ **/
+__attribute__((target("sse4.2")))
+static size_t index_search_sse4(const size_t *capacities, size_t n, size_t size, bool best) {
+    __m128i need   = _mm_set1_epi64x((int64_t)size - 1);
+    __m128i values = _mm_set1_epi64x(best ? INT64_MAX : -1);
+    __m128i slots  = _mm_set1_epi64x(-1);
+    __m128i slot   = _mm_set_epi64x(1, 0);
+    __m128i step   = _mm_set1_epi64x(2);
+    size_t  start  = 0;
+
+    for (; start + 2 <= n; start += 2) {
+        __m128i capacity = _mm_loadu_si128((const __m128i *)(capacities + start));
+        __m128i fits     = _mm_cmpgt_epi64(capacity, need);
+        __m128i better   = best ? _mm_cmpgt_epi64(values, capacity) : _mm_cmpgt_epi64(capacity, values);
+
+        better = _mm_and_si128(fits, better);
+        values = _mm_blendv_epi8(values, capacity, better);
+        slots  = _mm_blendv_epi8(slots, slot, better);
+        slot   = _mm_add_epi64(slot, step);
+    }
+
+    int64_t lane_capacities[2];
+    int64_t lane_slots[2];
+    _mm_storeu_si128((__m128i *)lane_capacities, values);
+    _mm_storeu_si128((__m128i *)lane_slots, slots);
+    return index_reduce(lane_capacities, lane_slots, 2, capacities, start, n, size, best);
+}
+
+/**
+ * Find the slot with the smallest (or largest) capacity that fits the
+ * specified size four slots at a time with AVX2 (see index_search_sse4).
+ **/
+__attribute__((target("avx2")))
+static size_t index_search_avx2(const size_t *capacities, size_t n, size_t size, bool best) {
+    __m256i need   = _mm256_set1_epi64x((int64_t)size - 1);
+    __m256i values = _mm256_set1_epi64x(best ? INT64_MAX : -1);
+    __m256i slots  = _mm256_set1_epi64x(-1);
+    __m256i slot   = _mm256_set_epi64x(3, 2, 1, 0);
+    __m256i step   = _mm256_set1_epi64x(4);
+    size_t  start  = 0;
+
+    for (; start + 4 <= n; start += 4) {
+        __m256i capacity = _mm256_loadu_si256((const __m256i *)(capacities + start));
+        __m256i fits     = _mm256_cmpgt_epi64(capacity, need);
+        __m256i better   = best ? _mm256_cmpgt_epi64(values, capacity) : _mm256_cmpgt_epi64(capacity, values);
+
+        better = _mm256_and_si256(fits, better);
+        values = _mm256_blendv_epi8(values, capacity, better);
+        slots  = _mm256_blendv_epi8(slots, slot, better);
+        slot   = _mm256_add_epi64(slot, step);
+    }
+
+    int64_t lane_capacities[4];
+    int64_t lane_slots[4];
+    _mm256_storeu_si256((__m256i *)lane_capacities, values);
+    _mm256_storeu_si256((__m256i *)lane_slots, slots);
+    return index_reduce(lane_capacities, lane_slots, 4, capacities, start, n, size, best);
+}
+
+/**
+ * Map the slot arrays and select the search kernel supported by the CPU
+ * (unless INDEX_ISA_ENV asks for a lower one).
+ *
+ * Note, this should only be called once (from init_counters).
+ **/
+void    index_init() {
+    char *isa = getenv(INDEX_ISA_ENV);
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && (!isa || !strcmp(isa, "avx2"))) {
+        IndexSearch = index_search_avx2;
+        IndexKernel = "avx2";
+    } else if (__builtin_cpu_supports("sse4.2") && (!isa || strcmp(isa, "scalar"))) {
+        IndexSearch = index_search_sse4;
+        IndexKernel = "sse4";
+    } else {
+        IndexSearch = index_search_scalar;
+        IndexKernel = "scalar";
+    }
+
+    size_t *capacities = mmap(NULL, INDEX_SLOTS * sizeof(size_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    Block **blocks     = mmap(NULL, INDEX_SLOTS * sizeof(Block *), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (capacities == MAP_FAILED || blocks == MAP_FAILED) {
+        return;
+    }
+
+    IndexCapacities = capacities;
+    IndexBlocks     = blocks;
+    IndexCount      = 0;
+    IndexSlots      = INDEX_SLOTS;
+    IndexEnabled    = true;
+}
+
+/**
+ * Double the number of slots.
+ * @return  Whether or not the slot arrays were grown.
+ **/
+static bool index_grow() {
+    size_t  slots      = IndexSlots << 1;
+    size_t *capacities = mremap(IndexCapacities, IndexSlots * sizeof(size_t), slots * sizeof(size_t), MREMAP_MAYMOVE);
+    if (capacities == MAP_FAILED) {
+        return false;
+    }
+    IndexCapacities = capacities;
+
+    Block **blocks = mremap(IndexBlocks, IndexSlots * sizeof(Block *), slots * sizeof(Block *), MREMAP_MAYMOVE);
+    if (blocks == MAP_FAILED) {
+        return false;
+    }
+    IndexBlocks = blocks;
+    IndexSlots  = slots;
+    return true;
+}
+
+/**
+ * Add the specified free block to the index.
+ *
+ * Note, if the slots cannot grow, the index is disabled (and the free list
+ * is searched directly from then on).
+ *
+ * @param   block   Pointer to block inserted into the free list.
+ **/
+void    index_insert(Block *block) {
+    if (!IndexEnabled) {
+        return;
+    }
+
+    if (IndexCount == IndexSlots && !index_grow()) {
+        IndexEnabled = false;
+        return;
+    }
+
+    IndexCapacities[IndexCount] = block->capacity;
+    IndexBlocks[IndexCount]     = block;
+    INDEX_SLOT(block)           = IndexCount++;
+}
+
+/**
+ * Remove the specified block from the index by moving the last slot into its
+ * place.
+ * @param   block   Pointer to block removed from the free list.
+ **/
+void    index_remove(Block *block) {
+    if (!IndexEnabled) {
+        return;
+    }
+
+    size_t slot = INDEX_SLOT(block);
+    size_t last = --IndexCount;
+
+    IndexCapacities[slot]           = IndexCapacities[last];
+    IndexBlocks[slot]               = IndexBlocks[last];
+    INDEX_SLOT(IndexBlocks[slot])   = slot;
+}
+
+/**
+ * Give the slot of an indexed block to another block (e.g. when the block
+ * was merged into the other block or split off from it).
+ * @param   old_block   Pointer to indexed block.
+ * @param   new_block   Pointer to block taking its place.
+ **/
+void    index_replace(Block *old_block, Block *new_block) {
+    if (!IndexEnabled) {
+        return;
+    }
+
+    size_t slot = INDEX_SLOT(old_block);
+
+    IndexCapacities[slot] = new_block->capacity;
+    IndexBlocks[slot]     = new_block;
+    INDEX_SLOT(new_block) = slot;
+}
+
+/**
+ * Update the capacity of an indexed block (e.g. when another block was
+ * merged into it).
+ * @param   block   Pointer to indexed block.
+ **/
+void    index_update(Block *block) {
+    if (IndexEnabled) {
+        IndexCapacities[INDEX_SLOT(block)] = block->capacity;
+    }
+}
+
+/**
+ * Search the index for the free block with the smallest capacity that fits
+ * the specified size.
+ * @param   size    Amount of memory required.
+ * @return  Pointer to existing block (otherwise NULL if none are available).
+ **/
+Block * index_search_bf(size_t size) {
+    size_t slot = IndexSearch(IndexCapacities, IndexCount, size, true);
+    if (slot == SIZE_MAX) {
+        return NULL;
+    }
+
+    IndexBlocks[slot]->size = size;
+    return IndexBlocks[slot];
+}
+
+/**
+ * Search the index for the free block with the largest capacity that fits
+ * the specified size.
+ * @param   size    Amount of memory required.
+ * @return  Pointer to existing block (otherwise NULL if none are available).
+ **/
+Block * index_search_wf(size_t size) {
+    size_t slot = IndexSearch(IndexCapacities, IndexCount, size, false);
+    if (slot == SIZE_MAX) {
+        return NULL;
+    }
+
+    IndexBlocks[slot]->size = size;
+    return IndexBlocks[slot];
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,227 @@
+/* maxheap.c: Max-Heap Index
+ *
+ * When the library is built with worst fit, the blocks in the free list are
+ * also kept in a binary max-heap keyed on capacity, so that worst fit (and
+ * the largest free block of the fragmentation stats) is a peek at the root
+ * instead of a scan of the whole free list.
+ *
+ * Ties are broken by the position of the block in the free list (blocks that
+ * take the place of another block inherit its order), so the heap picks the
+ * same block as free_list_search_wf.
+ *
+ * As with the capacity index, each free block stores its slot in the first
+ * word of its data.
+ **/
+
+#define _GNU_SOURCE     /* For mremap */
+
+#include "malloc/maxheap.h"
+
+#include <sys/mman.h>
+
+/* Global Variables */
+
+bool                MaxHeapEnabled = false;
+
+static HeapNode *   MaxHeapNodes = NULL;
+static size_t       MaxHeapCount = 0;
+static size_t       MaxHeapSlots = 0;
+static size_t       MaxHeapOrder = 0;       /* Order of next appended block */
+static size_t       MaxHeapBytes = 0;       /* Sum of capacities */
+
+/* Functions */
+
+/**
+ * Return whether the node in slot a belongs above the node in slot b.
+ **/
+static inline bool maxheap_above(size_t a, size_t b) {
+    HeapNode *na = &MaxHeapNodes[a];
+    HeapNode *nb = &MaxHeapNodes[b];
+
+    return na->capacity > nb->capacity || (na->capacity == nb->capacity && na->order < nb->order);
+}
+
+/**
+ * Swap the nodes in the two slots (and update the slots stored in their
+ * blocks).
+ **/
+static inline void maxheap_swap(size_t a, size_t b) {
+    HeapNode node   = MaxHeapNodes[a];
+    MaxHeapNodes[a] = MaxHeapNodes[b];
+    MaxHeapNodes[b] = node;
+
+    MAXHEAP_SLOT(MaxHeapNodes[a].block) = a;
+    MAXHEAP_SLOT(MaxHeapNodes[b].block) = b;
+}
+
+/**
+ * Restore the heap order around the node in the specified slot by moving it
+ * up or down.
+ **/
+static void maxheap_sift(size_t slot) {
+    while (slot > 0 && maxheap_above(slot, (slot - 1) / 2)) {
+        maxheap_swap(slot, (slot - 1) / 2);
+        slot = (slot - 1) / 2;
+    }
+
+    for (;;) {
+        size_t top   = slot;
+        size_t left  = 2 * slot + 1;
+        size_t right = 2 * slot + 2;
+
+        if (left < MaxHeapCount && maxheap_above(left, top)) {
+            top = left;
+        }
+
+        if (right < MaxHeapCount && maxheap_above(right, top)) {
+            top = right;
+        }
+
+        if (top == slot) {
+            break;
+        }
+
+        maxheap_swap(slot, top);
+        slot = top;
+    }
+}
+
+/**
+ * Map the heap nodes.
+ *
+ * Note, this should only be called once (from init_counters).
+ **/
+void    maxheap_init() {
+    HeapNode *nodes = mmap(NULL, MAXHEAP_SLOTS * sizeof(HeapNode), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (nodes == MAP_FAILED) {
+        return;
+    }
+
+    MaxHeapNodes   = nodes;
+    MaxHeapCount   = 0;
+    MaxHeapSlots   = MAXHEAP_SLOTS;
+    MaxHeapOrder   = 0;
+    MaxHeapBytes   = 0;
+    MaxHeapEnabled = true;
+}
+
+/**
+ * Add the specified block (appended to the free list) to the heap.
+ *
+ * Note, if the nodes cannot grow, the heap is disabled (and the free list is
+ * searched directly from then on).
+ *
+ * @param   block   Pointer to block inserted into the free list.
+ **/
+void    maxheap_insert(Block *block) {
+    if (!MaxHeapEnabled) {
+        return;
+    }
+
+    if (MaxHeapCount == MaxHeapSlots) {
+        HeapNode *nodes = mremap(MaxHeapNodes, MaxHeapSlots * sizeof(HeapNode), 2 * MaxHeapSlots * sizeof(HeapNode), MREMAP_MAYMOVE);
+        if (nodes == MAP_FAILED) {
+            MaxHeapEnabled = false;
+            return;
+        }
+
+        MaxHeapNodes  = nodes;
+        MaxHeapSlots *= 2;
+    }
+
+    size_t slot = MaxHeapCount++;
+
+    MaxHeapNodes[slot]  = (HeapNode){block->capacity, MaxHeapOrder++, block};
+    MAXHEAP_SLOT(block) = slot;
+    MaxHeapBytes       += block->capacity;
+    maxheap_sift(slot);
+}
+
+/**
+ * Remove the specified block from the heap.
+ * @param   block   Pointer to block removed from the free list.
+ **/
+void    maxheap_remove(Block *block) {
+    if (!MaxHeapEnabled) {
+        return;
+    }
+
+    size_t slot   = MAXHEAP_SLOT(block);
+    MaxHeapBytes -= MaxHeapNodes[slot].capacity;
+
+    if (slot != --MaxHeapCount) {
+        MaxHeapNodes[slot] = MaxHeapNodes[MaxHeapCount];
+        MAXHEAP_SLOT(MaxHeapNodes[slot].block) = slot;
+        maxheap_sift(slot);
+    }
+}
+
+/**
+ * Give the node of a block in the heap to another block that takes its place
+ * in the free list (e.g. when the block was merged into the other block or
+ * split off from it).
+ * @param   old_block   Pointer to block in the heap.
+ * @param   new_block   Pointer to block taking its place.
+ **/
+void    maxheap_replace(Block *old_block, Block *new_block) {
+    if (!MaxHeapEnabled) {
+        return;
+    }
+
+    size_t slot   = MAXHEAP_SLOT(old_block);
+    MaxHeapBytes += new_block->capacity - MaxHeapNodes[slot].capacity;
+
+    MaxHeapNodes[slot].capacity = new_block->capacity;
+    MaxHeapNodes[slot].block    = new_block;
+    MAXHEAP_SLOT(new_block)     = slot;
+    maxheap_sift(slot);
+}
+
+/**
+ * Update the capacity of a block in the heap (e.g. when another block was
+ * merged into it).
+ * @param   block   Pointer to block in the heap.
+ **/
+void    maxheap_update(Block *block) {
+    maxheap_replace(block, block);
+}
+
+/**
+ * Return the free block with the largest capacity (otherwise NULL if the
+ * heap is empty).
+ **/
+Block * maxheap_peek() {
+    return MaxHeapCount ? MaxHeapNodes[0].block : NULL;
+}
+
+/**
+ * Search the heap for the free block with the largest capacity if it fits
+ * the specified size.
+ * @param   size    Amount of memory required.
+ * @return  Pointer to existing block (otherwise NULL if none are available).
+ **/
+Block * maxheap_search(size_t size) {
+    Block *largest = maxheap_peek();
+    if (!largest || largest->capacity < size) {
+        return NULL;
+    }
+
+    largest->size = size;
+    return largest;
+}
+
+/**
+ * Return number of blocks in the heap.
+ **/
+size_t  maxheap_length() {
+    return MaxHeapCount;
+}
+
+/**
+ * Return sum of the capacities of the blocks in the heap.
+ **/
+size_t  maxheap_bytes() {
+    return MaxHeapBytes;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
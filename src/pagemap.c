@@ -0,0 +1,215 @@
+/* pagemap.c: Page Map
+ *
+ * When PAGEMAP_ENV is set, every page that holds blocks is recorded in a
+ * three level radix tree indexed by page number (PAGEMAP_BITS of the page
+ * number per level, which covers 48 bit addresses), so that the kind of memory
+ * behind any address is found with three loads and without trusting the
+ * address.  The POSIX functions use it to ignore pointers that were not
+ * allocated by us (instead of reading a header that is not there).
+ *
+ * Blocks are not page aligned, so a page may be shared with memory that is
+ * not ours (e.g. the top page of the program break of someone else).  Every
+ * entry of a leaf holds the first and last byte of the page that are ours
+ * along with the kind, so an address on the rest of the page is foreign.  The
+ * range of a page grows as adjacent blocks are marked (a block that is not
+ * adjacent to the range of its page is left out, and treated as foreign).
+ *
+ * The root is static, and the interior nodes (PAGEMAP_FANOUT pointers) and
+ * leaves (PAGEMAP_FANOUT entries, one per page) are mapped the first time a
+ * page under them is marked and never unmapped, so the cost is bounded by the
+ * address space the heap has ever used (one 16 KiB leaf per 16 MiB).  Nodes
+ * are published with release stores, so lookups do not need the MainArena
+ * lock.
+ **/
+
+#include "malloc/counters.h"
+#include "malloc/pagemap.h"
+
+#include <sys/mman.h>
+
+/* Page Map Entries */
+
+#define PAGEMAP_OFFSET      ((1UL<<PAGEMAP_PAGE_SHIFT) - 1)
+#define PAGEMAP_KIND(e)     ((e) & 0xFF)
+#define PAGEMAP_FIRST(e)    (((e) >> 8) & PAGEMAP_OFFSET)
+#define PAGEMAP_LAST(e)     ((e) >> (8 + PAGEMAP_PAGE_SHIFT))
+#define PAGEMAP_ENTRY(kind, first, last) \
+    ((uint32_t)(kind) | (uint32_t)(first) << 8 | (uint32_t)(last) << (8 + PAGEMAP_PAGE_SHIFT))
+
+/* Global Variables */
+
+bool                PageMapEnabled = false;
+static uint32_t **  PageMapRoot[PAGEMAP_FANOUT];
+
+/* Functions */
+
+/**
+ * Enable the page map if the PAGEMAP_ENV environment variable is set to a
+ * nonzero number.
+ *
+ * Note, this should only be called once (from init_counters) before any block
+ * is allocated.
+ **/
+void    pagemap_init() {
+    char *pagemap = getenv(PAGEMAP_ENV);
+
+    PageMapEnabled = pagemap && atol(pagemap) > 0;
+    if (PageMapEnabled) {
+        Counters[PAGEMAP_BYTES] += sizeof(PageMapRoot);
+    }
+}
+
+/**
+ * Map a zeroed node of the specified size.
+ * @return  Pointer to node (otherwise NULL).
+ **/
+static void *pagemap_node(size_t size) {
+    void *node = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (node == MAP_FAILED) {
+        return NULL;
+    }
+
+    Counters[PAGEMAP_BYTES] += size;
+    return node;
+}
+
+/**
+ * Return the leaf of the specified page (mapping the nodes on the way if
+ * requested).
+ * @param   page    Page number.
+ * @param   create  Whether or not to map missing nodes.
+ * @return  Pointer to leaf (otherwise NULL).
+ **/
+static uint32_t *pagemap_leaf(uintptr_t page, bool create) {
+    if (page >> (3 * PAGEMAP_BITS)) {
+        return NULL;
+    }
+
+    uint32_t ***root   = &PageMapRoot[page >> (2 * PAGEMAP_BITS)];
+    uint32_t ** middle = __atomic_load_n(root, __ATOMIC_ACQUIRE);
+    if (!middle) {
+        if (!create || !(middle = pagemap_node(PAGEMAP_FANOUT * sizeof(uint32_t *)))) {
+            return NULL;
+        }
+        __atomic_store_n(root, middle, __ATOMIC_RELEASE);
+    }
+
+    uint32_t **slot = &middle[(page >> PAGEMAP_BITS) & PAGEMAP_MASK];
+    uint32_t * leaf = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (!leaf) {
+        if (!create || !(leaf = pagemap_node(PAGEMAP_FANOUT * sizeof(uint32_t)))) {
+            return NULL;
+        }
+        __atomic_store_n(slot, leaf, __ATOMIC_RELEASE);
+    }
+
+    return leaf;
+}
+
+/**
+ * Record the kind of the specified range on every page it overlaps.
+ *
+ * Note, this requires the MainArena lock.
+ *
+ * @param   start   Start of range.
+ * @param   length  Number of bytes in range.
+ * @param   kind    Kind of memory in range.
+ * @return  Whether or not the whole range was recorded (the blocks on the
+ * parts that were not are treated as foreign, so they leak instead of being
+ * trusted).
+ **/
+bool    pagemap_mark(const void *start, size_t length, uint8_t kind) {
+    if (!PageMapEnabled || !length) {
+        return true;
+    }
+
+    uintptr_t begin    = (uintptr_t)start;
+    uintptr_t end      = begin + length - 1;
+    uintptr_t first    = begin >> PAGEMAP_PAGE_SHIFT;
+    uintptr_t last     = end >> PAGEMAP_PAGE_SHIFT;
+    bool      recorded = true;
+
+    for (uintptr_t page = first; page <= last; page++) {
+        uint32_t *leaf = pagemap_leaf(page, true);
+        if (!leaf) {
+            return false;
+        }
+
+        uintptr_t low   = page == first ? begin & PAGEMAP_OFFSET : 0;
+        uintptr_t high  = page == last  ? end & PAGEMAP_OFFSET : PAGEMAP_OFFSET;
+        uint32_t  entry = leaf[page & PAGEMAP_MASK];
+
+        // Grow the range of a page shared with blocks marked before
+        if (PAGEMAP_KIND(entry)) {
+            if (low > PAGEMAP_LAST(entry) + 1 || high + 1 < PAGEMAP_FIRST(entry)) {
+                recorded = false;
+                continue;
+            }
+            low  = low  < PAGEMAP_FIRST(entry) ? low  : PAGEMAP_FIRST(entry);
+            high = high > PAGEMAP_LAST(entry)  ? high : PAGEMAP_LAST(entry);
+        }
+
+        __atomic_store_n(&leaf[page & PAGEMAP_MASK], PAGEMAP_ENTRY(kind, low, high), __ATOMIC_RELAXED);
+    }
+
+    return recorded;
+}
+
+/**
+ * Forget the specified range on every page it overlaps.
+ *
+ * Note, this requires the MainArena lock, and the memory right above the range
+ * must not hold any blocks (e.g. it was the top of the heap or a mapping), so
+ * only the part of the first page below the range is kept.
+ *
+ * @param   start   Start of range.
+ * @param   length  Number of bytes in range.
+ **/
+void    pagemap_clear(const void *start, size_t length) {
+    if (!PageMapEnabled || !length) {
+        return;
+    }
+
+    uintptr_t begin = (uintptr_t)start;
+    uintptr_t first = begin >> PAGEMAP_PAGE_SHIFT;
+    uintptr_t last  = (begin + length - 1) >> PAGEMAP_PAGE_SHIFT;
+
+    for (uintptr_t page = first; page <= last; page++) {
+        uint32_t *leaf = pagemap_leaf(page, false);
+        if (!leaf) {
+            continue;
+        }
+
+        uint32_t  entry = leaf[page & PAGEMAP_MASK];
+        uintptr_t below = begin & PAGEMAP_OFFSET;
+        if (page == first && PAGEMAP_KIND(entry) && PAGEMAP_FIRST(entry) < below) {
+            uintptr_t high = PAGEMAP_LAST(entry) < below ? PAGEMAP_LAST(entry) : below - 1;
+            entry = PAGEMAP_ENTRY(PAGEMAP_KIND(entry), PAGEMAP_FIRST(entry), high);
+        } else {
+            entry = PAGEMAP_NONE;
+        }
+
+        __atomic_store_n(&leaf[page & PAGEMAP_MASK], entry, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Return the kind of memory at the specified address.
+ * @param   address     Any address.
+ * @return  Kind of memory (PAGEMAP_NONE if it is not ours).
+ **/
+uint8_t pagemap_lookup(const void *address) {
+    uintptr_t page  = (uintptr_t)address >> PAGEMAP_PAGE_SHIFT;
+    uint32_t *leaf  = pagemap_leaf(page, false);
+    uint32_t  entry = leaf ? __atomic_load_n(&leaf[page & PAGEMAP_MASK], __ATOMIC_RELAXED) : PAGEMAP_NONE;
+
+    // The rest of a page shared with memory that is not ours is not ours
+    uintptr_t offset = (uintptr_t)address & PAGEMAP_OFFSET;
+    if (offset < PAGEMAP_FIRST(entry) || offset > PAGEMAP_LAST(entry)) {
+        return PAGEMAP_NONE;
+    }
+
+    return PAGEMAP_KIND(entry);
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
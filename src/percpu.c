@@ -0,0 +1,471 @@
+/* percpu.c: Per-CPU Caches
+ *
+ * When the library is built with PERCPU, small blocks (up to PERCPU_MAX bytes)
+ * are freed into a cache owned by the CPU the thread is running on, and
+ * malloc pops them from there without taking the MainArena lock.  Each cache
+ * holds a bounded stack of blocks for every size class, so the memory held by
+ * the caches scales with the number of CPUs rather than the number of
+ * threads.
+ *
+ * On x86-64 Linux, the caches are accessed inside restartable sequences
+ * (rseq) registered by glibc: the kernel aborts and restarts the sequence if
+ * the thread is preempted or migrated before the single store that commits
+ * the push or pop, so no lock or atomic instruction is needed.  Otherwise,
+ * the cache of the CPU reported by sched_getcpu is protected by its own lock.
+ *
+ * The mallocs and frees served by the caches never touch the Counters, so
+ * each cache counts its own, and percpu_collect adds them to the Counters
+ * (whenever they are published or dumped).
+ **/
+
+#define _GNU_SOURCE     /* For sched_getcpu */
+
+#include "malloc/counters.h"
+#include "malloc/percpu.h"
+#include "malloc/profile.h"
+#include "malloc/sites.h"
+#include "malloc/stats.h"
+
+#include <sched.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/sysinfo.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/rseq.h>
+#define PERCPU_RSEQ 1
+#else
+#define PERCPU_RSEQ 0
+#endif
+
+/* Global Variables */
+
+bool    PerCpuEnabled = false;
+bool    PerCpuRseq    = false;
+
+static CpuCache *   PerCpuCaches = NULL;
+static unsigned int PerCpuCount  = 0;
+
+static size_t       PerCpuMallocs   = 0;    /* Mallocs already collected */
+static size_t       PerCpuFrees     = 0;    /* Frees already collected */
+static size_t       PerCpuRequested = 0;    /* Bytes already collected */
+
+/* Functions */
+
+/**
+ * Re-initialize the cache locks in the child after fork.
+ **/
+static void percpu_child() {
+    for (unsigned int cpu = 0; cpu < PerCpuCount; cpu++) {
+        pthread_mutex_init(&PerCpuCaches[cpu].lock, NULL);
+    }
+}
+
+/**
+ * Map one cache for every configured CPU, unless allocations are being
+ * profiled or attributed to call sites (which must see every malloc and
+ * free).
+ *
+ * Note, this should only be called once (from init_counters).
+ **/
+void    percpu_init() {
+    if (ProfileEnabled || SitesEnabled) {
+        return;
+    }
+
+    unsigned int count  = get_nprocs_conf() > 0 ? get_nprocs_conf() : 1;
+    CpuCache *   caches = mmap(NULL, count * sizeof(CpuCache), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (caches == MAP_FAILED) {
+        return;
+    }
+
+    for (unsigned int cpu = 0; cpu < count; cpu++) {
+        pthread_mutex_init(&caches[cpu].lock, NULL);
+    }
+
+    PerCpuCaches  = caches;
+    PerCpuCount   = count;
+#if PERCPU_RSEQ
+    PerCpuRseq    = __rseq_size > 0;
+#endif
+    PerCpuEnabled = true;
+    pthread_atfork(NULL, NULL, percpu_child);
+}
+
+/**
+ * Compute the size class of the specified number of bytes.
+ **/
+static size_t percpu_class(size_t size) {
+    return size / PERCPU_CLASS - 1;
+}
+
+#if PERCPU_RSEQ
+/**
+ * Pop the top block of the specified size class from the cache of the current
+ * CPU inside a restartable sequence.
+ * @param   cls     Size class.
+ * @return  Pointer to block (otherwise NULL if the stack is empty).
+ **/
+static Block *percpu_rseq_pop(size_t cls) {
+    struct rseq *rseq = (struct rseq *)((char *)__builtin_thread_pointer() + __rseq_offset);
+    Block *      block;
+
+    __asm__ __volatile__ (
+        ".pushsection __rseq_cs, \"aw\"\n\t"
+        ".balign 32\n\t"
+        "3:\n\t"
+        ".long 0, 0\n\t"
+        ".quad 1f, 2f - 1f, 4f\n\t"
+        ".popsection\n\t"
+        "6:\n\t"
+        "leaq 3b(%%rip), %%rax\n\t"
+        "movq %%rax, %c[cs](%[rseq])\n\t"
+        "1:\n\t"
+        "xorl %%edx, %%edx\n\t"
+        "movl %c[cpu](%[rseq]), %%eax\n\t"
+        "cmpl %k[ncpus], %%eax\n\t"
+        "jae 2f\n\t"
+        "imulq %[stride], %%rax\n\t"
+        "addq %[caches], %%rax\n\t"
+        "movq %c[count](%%rax, %[cls], 8), %%rcx\n\t"
+        "testq %%rcx, %%rcx\n\t"
+        "jz 2f\n\t"
+        "subq $1, %%rcx\n\t"
+        "movq %[cls], %%rdx\n\t"
+        "shlq %[shift], %%rdx\n\t"
+        "addq %%rcx, %%rdx\n\t"
+        "movq %c[slots](%%rax, %%rdx, 8), %%rdx\n\t"
+        "movq %%rcx, %c[count](%%rax, %[cls], 8)\n\t"   /* Commit */
+        "2:\n\t"
+        "jmp 5f\n\t"
+        ".long %c[sig]\n\t"
+        "4:\n\t"
+        "jmp 6b\n\t"
+        "5:\n\t"
+        : "=&d" (block)
+        : [rseq]   "r" (rseq),
+          [caches] "r" (PerCpuCaches),
+          [ncpus]  "r" (PerCpuCount),
+          [stride] "r" (sizeof(CpuCache)),
+          [cls]    "r" (cls),
+          [cs]     "i" (offsetof(struct rseq, rseq_cs)),
+          [cpu]    "i" (offsetof(struct rseq, cpu_id)),
+          [count]  "i" (offsetof(CpuCache, count)),
+          [slots]  "i" (offsetof(CpuCache, slots)),
+          [shift]  "i" (PERCPU_SHIFT),
+          [sig]    "i" (RSEQ_SIG)
+        : "rax", "rcx", "memory", "cc");
+
+    return block;
+}
+
+/**
+ * Push a block onto the stack of the specified size class in the cache of
+ * the current CPU inside a restartable sequence.
+ * @param   cls     Size class.
+ * @param   block   Pointer to block being freed.
+ * @return  Whether or not the block was cached (the stack may be full).
+ **/
+static bool percpu_rseq_push(size_t cls, Block *block) {
+    struct rseq *rseq = (struct rseq *)((char *)__builtin_thread_pointer() + __rseq_offset);
+    size_t       pushed;
+
+    __asm__ __volatile__ (
+        ".pushsection __rseq_cs, \"aw\"\n\t"
+        ".balign 32\n\t"
+        "3:\n\t"
+        ".long 0, 0\n\t"
+        ".quad 1f, 2f - 1f, 4f\n\t"
+        ".popsection\n\t"
+        "6:\n\t"
+        "leaq 3b(%%rip), %%rax\n\t"
+        "movq %%rax, %c[cs](%[rseq])\n\t"
+        "1:\n\t"
+        "xorl %%edx, %%edx\n\t"
+        "movl %c[cpu](%[rseq]), %%eax\n\t"
+        "cmpl %k[ncpus], %%eax\n\t"
+        "jae 2f\n\t"
+        "imulq %[stride], %%rax\n\t"
+        "addq %[caches], %%rax\n\t"
+        "movq %c[count](%%rax, %[cls], 8), %%rcx\n\t"
+        "cmpq %[depth], %%rcx\n\t"
+        "jae 2f\n\t"
+        "movq %[cls], %%rdx\n\t"
+        "shlq %[shift], %%rdx\n\t"
+        "addq %%rcx, %%rdx\n\t"
+        "movq %[block], %c[slots](%%rax, %%rdx, 8)\n\t"
+        "addq $1, %%rcx\n\t"
+        "movl $1, %%edx\n\t"
+        "movq %%rcx, %c[count](%%rax, %[cls], 8)\n\t"   /* Commit */
+        "2:\n\t"
+        "jmp 5f\n\t"
+        ".long %c[sig]\n\t"
+        "4:\n\t"
+        "jmp 6b\n\t"
+        "5:\n\t"
+        : "=&d" (pushed)
+        : [rseq]   "r" (rseq),
+          [caches] "r" (PerCpuCaches),
+          [ncpus]  "r" (PerCpuCount),
+          [stride] "r" (sizeof(CpuCache)),
+          [cls]    "r" (cls),
+          [block]  "r" (block),
+          [depth]  "i" (PERCPU_DEPTH),
+          [cs]     "i" (offsetof(struct rseq, rseq_cs)),
+          [cpu]    "i" (offsetof(struct rseq, cpu_id)),
+          [count]  "i" (offsetof(CpuCache, count)),
+          [slots]  "i" (offsetof(CpuCache, slots)),
+          [shift]  "i" (PERCPU_SHIFT),
+          [sig]    "i" (RSEQ_SIG)
+        : "rax", "rcx", "memory", "cc");
+
+    return pushed;
+}
+#endif
+
+/**
+ * Find the cache of the CPU the thread is running on.
+ *
+ * Note, the thread may migrate at any time, so this is only suitable for
+ * statistics or for taking the lock of the cache.
+ *
+ * @return  Pointer to the cache.
+ **/
+static CpuCache *percpu_cache() {
+    int cpu;
+
+#if PERCPU_RSEQ
+    if (PerCpuRseq) {
+        cpu = ((struct rseq *)((char *)__builtin_thread_pointer() + __rseq_offset))->cpu_id;
+    } else
+#endif
+    {
+        cpu = sched_getcpu();
+    }
+
+    return &PerCpuCaches[cpu >= 0 && cpu < PerCpuCount ? cpu : 0];
+}
+
+/**
+ * Take a cached block that fits the specified size from the cache of the
+ * current CPU.
+ * @param   size    Number of bytes requested (at most PERCPU_MAX).
+ * @return  Pointer to allocated block (otherwise NULL if none is cached).
+ **/
+Block * percpu_pop(size_t size) {
+    size_t cls   = percpu_class(PERCPU_SIZE(size));
+    Block *block = NULL;
+
+#if PERCPU_RSEQ
+    if (PerCpuRseq) {
+        block = percpu_rseq_pop(cls);
+    } else
+#endif
+    {
+        CpuCache *cache = percpu_cache();
+        pthread_mutex_lock(&cache->lock);
+        if (cache->count[cls]) {
+            block = cache->slots[cls][--cache->count[cls]];
+        }
+        pthread_mutex_unlock(&cache->lock);
+    }
+
+    if (block) {
+        CpuCache *cache = percpu_cache();
+
+        block->size = size;
+        __atomic_fetch_add(&cache->mallocs, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&cache->requested, size, __ATOMIC_RELAXED);
+    }
+    return block;
+}
+
+/**
+ * Keep a freed block in the stack of the specified size class in the cache
+ * of the current CPU if the stack is not full.
+ * @param   block   Pointer to block being freed.
+ * @param   cls     Size class.
+ * @return  Whether or not the block was cached.
+ **/
+static bool percpu_cache_block(Block *block, size_t cls) {
+    bool pushed = false;
+
+#if PERCPU_RSEQ
+    if (PerCpuRseq) {
+        pushed = percpu_rseq_push(cls, block);
+    } else
+#endif
+    {
+        CpuCache *cache = percpu_cache();
+        pthread_mutex_lock(&cache->lock);
+        if (cache->count[cls] < PERCPU_DEPTH) {
+            cache->slots[cls][cache->count[cls]++] = block;
+            pushed = true;
+        }
+        pthread_mutex_unlock(&cache->lock);
+    }
+
+    if (pushed) {
+        __atomic_fetch_add(&percpu_cache()->frees, 1, __ATOMIC_RELAXED);
+    }
+    return pushed;
+}
+
+/**
+ * Keep a freed block in the cache of the current CPU if it is small enough
+ * and the stack of its size class is not full.
+ * @param   block   Pointer to block being freed.
+ * @return  Whether or not the block was cached.
+ **/
+bool    percpu_push(Block *block) {
+    if (block->capacity < PERCPU_CLASS || block->capacity > PERCPU_MAX) {
+        return false;
+    }
+
+    return percpu_cache_block(block, percpu_class(block->capacity));
+}
+
+/**
+ * Keep a freed block in the cache of the current CPU using the size it was
+ * requested with to pick the size class, so the block header is not read.
+ *
+ * Note, this is only valid for blocks whose capacity is at least the size
+ * rounded up to its size class, which posix.c ensures for every small block
+ * it hands out once the caches are enabled.
+ *
+ * @param   block   Pointer to block being freed.
+ * @param   size    Number of bytes originally requested.
+ * @return  Whether or not the block was cached.
+ **/
+bool    percpu_push_sized(Block *block, size_t size) {
+    if (!size || size > PERCPU_MAX) {
+        return false;
+    }
+
+    return percpu_cache_block(block, percpu_class(PERCPU_SIZE(size)));
+}
+
+/**
+ * Add the mallocs, frees and requested bytes that the caches served since the
+ * last collection to the MALLOCS, FREES and REQUESTED counters.
+ *
+ * Note, this requires the MainArena lock.
+ **/
+void    percpu_collect() {
+    size_t mallocs   = 0;
+    size_t frees     = 0;
+    size_t requested = 0;
+
+    for (unsigned int cpu = 0; cpu < PerCpuCount; cpu++) {
+        mallocs   += __atomic_load_n(&PerCpuCaches[cpu].mallocs, __ATOMIC_RELAXED);
+        frees     += __atomic_load_n(&PerCpuCaches[cpu].frees, __ATOMIC_RELAXED);
+        requested += __atomic_load_n(&PerCpuCaches[cpu].requested, __ATOMIC_RELAXED);
+    }
+
+    Counters[MALLOCS]   += mallocs - PerCpuMallocs;
+    Counters[FREES]     += frees - PerCpuFrees;
+    Counters[REQUESTED] += requested - PerCpuRequested;
+
+    PerCpuMallocs   = mallocs;
+    PerCpuFrees     = frees;
+    PerCpuRequested = requested;
+}
+
+/**
+ * Count the blocks held by the specified cache.
+ *
+ * Note, every cached block is counted by the size of its class (which its
+ * capacity is at least), since reading the header of a block that another CPU
+ * may pop at any time is not safe.
+ *
+ * @param   cache   Pointer to the cache.
+ * @param   bytes   Where to store the bytes held by the cache.
+ * @return  Number of blocks held by the cache.
+ **/
+static size_t percpu_cached(CpuCache *cache, size_t *bytes) {
+    size_t cached = 0;
+
+    *bytes = 0;
+    for (size_t cls = 0; cls < PERCPU_CLASSES; cls++) {
+        size_t count = __atomic_load_n(&cache->count[cls], __ATOMIC_RELAXED);
+        cached += count;
+        *bytes += count * (cls + 1) * PERCPU_CLASS;
+    }
+
+    return cached;
+}
+
+/**
+ * Return the number of blocks held by the caches of all CPUs.
+ **/
+size_t  percpu_length() {
+    size_t cached = 0;
+    size_t bytes;
+
+    for (unsigned int cpu = 0; cpu < PerCpuCount; cpu++) {
+        cached += percpu_cached(&PerCpuCaches[cpu], &bytes);
+    }
+
+    return cached;
+}
+
+/**
+ * Return the bytes held by the caches of all CPUs (see percpu_cached).
+ **/
+size_t  percpu_bytes() {
+    size_t total = 0;
+    size_t bytes;
+
+    for (unsigned int cpu = 0; cpu < PerCpuCount; cpu++) {
+        percpu_cached(&PerCpuCaches[cpu], &bytes);
+        total += bytes;
+    }
+
+    return total;
+}
+
+/**
+ * Break the hits, frees and cached blocks down by CPU into the specified
+ * entries of the stats page.
+ * @param   cpus    Array of per-CPU entries of the stats page.
+ * @param   n       Number of entries available.
+ * @return  Number of entries filled in.
+ **/
+size_t  percpu_publish(StatsCpu *cpus, size_t n) {
+    size_t count = PerCpuCount < n ? PerCpuCount : n;
+
+    for (size_t cpu = 0; cpu < count; cpu++) {
+        CpuCache *cache = &PerCpuCaches[cpu];
+
+        cpus[cpu].mallocs = __atomic_load_n(&cache->mallocs, __ATOMIC_RELAXED);
+        cpus[cpu].frees   = __atomic_load_n(&cache->frees, __ATOMIC_RELAXED);
+        cpus[cpu].cached  = percpu_cached(cache, &cpus[cpu].cached_bytes);
+    }
+
+    return count;
+}
+
+/**
+ * Display the per-CPU cache statistics to the specified file descriptor.
+ * @param   fd      File descriptor to write to.
+ **/
+void    percpu_dump(int fd) {
+    char   buffer[BUFSIZ];
+    size_t mallocs = 0;
+    size_t frees   = 0;
+    size_t cached  = percpu_length();
+
+    for (unsigned int cpu = 0; cpu < PerCpuCount; cpu++) {
+        mallocs += PerCpuCaches[cpu].mallocs;
+        frees   += PerCpuCaches[cpu].frees;
+    }
+
+    fdprintf(fd, buffer, "cpu caches:  %u (%s)\n", PerCpuCount, PerCpuRseq ? "rseq" : "sched_getcpu");
+    fdprintf(fd, buffer, "cpu mallocs: %lu\n"    , mallocs);
+    fdprintf(fd, buffer, "cpu frees:   %lu\n"    , frees);
+    fdprintf(fd, buffer, "cpu cached:  %lu\n"    , cached);
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -1,10 +1,80 @@
 /* posix.c: POSIX API Implementation */
 
+#include "malloc/arena.h"
+#include "malloc/buddy.h"
+#include "malloc/bulk.h"
 #include "malloc/counters.h"
+#include "malloc/fastbins.h"
 #include "malloc/freelist.h"
+#include "malloc/pagemap.h"
+#include "malloc/percpu.h"
+#include "malloc/profile.h"
+#include "malloc/sites.h"
+#include "malloc/sized.h"
+#include "malloc/stats.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <malloc.h>
+#include <stdint.h>
 #include <string.h>
+#include <unistd.h>
+
+/* Global Variables */
+
+extern Block FreeList;
+
+static void *CallSite = NULL;   /* Caller of calloc, realloc, or memalign */
+
+/* Functions */
+
+/**
+ * Return whether or not the specified pointer was not allocated by us (and
+ * count it), which is only known when the page map is enabled.
+ * @param   ptr     Pointer to memory being freed or reallocated.
+ **/
+static bool foreign_pointer(void *ptr) {
+    if (!PageMapEnabled || (pagemap_lookup(BLOCK_FROM_POINTER(ptr)) && pagemap_lookup(ptr))) {
+        return false;
+    }
+
+    arena_lock(&MainArena);
+    Counters[FOREIGN_POINTERS]++;
+    arena_unlock(&MainArena);
+    return true;
+}
+
+/**
+ * Round a small size up to its per-CPU size class once the caches are
+ * enabled, so that every small block handed out holds the class free_sized
+ * picks from the requested size alone.
+ * @param   size    Amount of bytes requested.
+ * @return  Amount of bytes to allocate.
+ **/
+static size_t size_class(size_t size) {
+#if PERCPU
+    if (PerCpuEnabled && size && size <= PERCPU_MAX) {
+        return PERCPU_SIZE(size);
+    }
+#endif
+    return size;
+}
+
+/**
+ * Release a block through the arena, deferring it to the lock holder if the
+ * arena is busy.
+ * @param   block   Pointer to block being freed.
+ **/
+static void free_block(Block *block) {
+    if (!arena_trylock(&MainArena)) {
+        arena_push(&MainArena, block);
+        return;
+    }
+
+    arena_free(&MainArena, block);
+    stats_publish();
+    arena_unlock(&MainArena);
+}
 
 /**
  * Allocate specified amount memory.
@@ -12,28 +82,62 @@
  * @return  Pointer to the requested amount of memory.
  **/
 void *malloc(size_t size) {
+#if PERCPU
+    // Reuse a small block from the cache of the current CPU
+    if (PerCpuEnabled && size && size <= PERCPU_MAX) {
+        Block *block = percpu_pop(size);
+        if (block) {
+            return block->data;
+        }
+
+        // Round up to the size class so the block can be cached when freed
+        size = PERCPU_SIZE(size);
+    }
+#endif
+
+    arena_lock(&MainArena);
+
     // Initialize counters
     init_counters();
 
+    // Round up the first allocation too (PerCpuEnabled is set by init_counters)
+    size = size_class(size);
+
+    // Free blocks deferred by other threads
+    arena_collect(&MainArena);
+
     // Handle empty size
     if (!size) {
+        arena_unlock(&MainArena);
         return NULL;
     }
 
-    // TODO: Search free list for any available block with matching size
+    // Search free list for any available block with matching size
+    size_t grows  = Counters[GROWS];
+    size_t splits = Counters[SPLITS];
 
-    Block *block = free_list_search(size);
+    Block *block = FastBinsEnabled ? fastbins_pop(size) : NULL;
 
-    if(!block) {
-        block = block_allocate(size);
-    }
-    else {
-        block = block_split(block, size);
-        block = block_detach(block);
+    if (!block) {
+        block = free_list_search(size);
+
+        // Merge the fast bins into the free list before growing the heap
+        if (!block && FastBinsEnabled && fastbins_consolidate()) {
+            block = free_list_search(size);
+        }
+
+        if(!block) {
+            block = block_allocate(size);
+        }
+        else {
+            block = free_list_take(block, size);
+        }
     }
 
     // Could not find free block or allocate a block, so just return NULL
     if (!block) {
+        arena_unlock(&MainArena);
+        errno = ENOMEM;
         return NULL;
     }
 
@@ -46,29 +150,94 @@ void *malloc(size_t size) {
     // Update counters
     Counters[MALLOCS]++;
     Counters[REQUESTED] += size;
+    stats_publish();
+
+    if (ProfileEnabled) {
+        profile_malloc(block->data, size);
+    }
+
+    if (SitesEnabled) {
+        void *site = CallSite ? CallSite : __builtin_return_address(0);
+        sites_malloc(block, site, Counters[GROWS] - grows, Counters[SPLITS] - splits);
+    }
 
     // Return data address associated with block
+    arena_unlock(&MainArena);
     return block->data;
 }
 
 /**
  * Release previously allocated memory.
+ *
+ * Note, with the page map enabled, pointers that are not ours are ignored.
+ *
  * @param   ptr     Pointer to previously allocated memory.
  **/
 void free(void *ptr) {
-    if (!ptr) {
+    if (!ptr || foreign_pointer(ptr)) {
         return;
     }
 
-    // Update counters
-    Counters[FREES]++;
+    Block *block = BLOCK_FROM_POINTER(ptr);
+
+#if PERCPU
+    // Keep a small block in the cache of the current CPU
+    if (PerCpuEnabled && percpu_push(block)) {
+        return;
+    }
+#endif
+
+    // Defer to the lock holder rather than wait if the arena is busy
+    free_block(block);
+}
+
+/**
+ * Release previously allocated memory whose size is known to the caller.
+ *
+ * Note, the size picks the per-CPU size class directly (every small block is
+ * rounded up to its class, see size_class), so the block header is not read
+ * unless assertions are enabled (where it is checked against the size) or the
+ * block has to go back to the arena.
+ *
+ * @param   ptr     Pointer to memory allocated by malloc, calloc, or realloc.
+ * @param   size    Amount of bytes originally requested.
+ **/
+void free_sized(void *ptr, size_t size) {
+    if (!ptr || foreign_pointer(ptr)) {
+        return;
+    }
 
-    // TODO: Try to release block, otherwise insert it into the free list
     Block *block = BLOCK_FROM_POINTER(ptr);
 
-    if (!block_release(block)) {
-        free_list_insert(block);
+#ifndef NDEBUG
+    assert(size && size <= block->size && block->size <= block->capacity);
+    assert(size_class(size) <= block->capacity);
+#endif
+
+#if PERCPU
+    // Keep a small block in the cache of the current CPU
+    if (PerCpuEnabled && percpu_push_sized(block, size)) {
+        return;
     }
+#endif
+
+    free_block(block);
+}
+
+/**
+ * Release previously allocated aligned memory whose size and alignment are
+ * known to the caller.
+ *
+ * Note, aligned blocks are rounded up to a size class too (see
+ * aligned_malloc), so they are released like any other sized block.
+ *
+ * @param   ptr         Pointer to memory allocated by aligned_alloc.
+ * @param   alignment   Alignment the memory was allocated with.
+ * @param   size        Amount of bytes originally requested.
+ **/
+void free_aligned_sized(void *ptr, size_t alignment, size_t size) {
+    assert(!ptr || (uintptr_t)ptr % alignment == 0);
+    free_sized(ptr, size);
 }
 
 /**
@@ -79,45 +248,504 @@ void free(void *ptr) {
  * @return  Pointer to requested amount of memory.
  **/
 void *calloc(size_t nmemb, size_t size) {
-    // TODO: Implement calloc
+    // Refuse sizes whose product does not fit
+    if (size && nmemb > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    arena_lock(&MainArena);
     Counters[CALLOCS]++;
     size_t total_size = nmemb * size;
+    CallSite  = __builtin_return_address(0);
     void *ptr = malloc(total_size);
-    memset(ptr, 0, total_size);
+    CallSite  = NULL;
+    arena_unlock(&MainArena);
+
+    if (ptr) {
+        memset(ptr, 0, total_size);
+    }
     return ptr;
 }
 
 /**
  * Reallocate memory with specified size.
+ *
+ * Note, a block with a mapping of its own (see block_resize) is grown or
+ * shrunk with mremap instead of being copied to a new block.
+ *
  * @param   ptr     Pointer to previously allocated memory.
  * @param   size    Amount of bytes to allocate.
  * @return  Pointer to requested amount of memory.
  **/
 void *realloc(void *ptr, size_t size) {
-    // TODO: Implement realloc
+    arena_lock(&MainArena);
     Counters[REALLOCS]++;
 
     if (!ptr) {
-        return malloc(size);
+        CallSite = __builtin_return_address(0);
+        ptr      = malloc(size);
+        CallSite = NULL;
+        arena_unlock(&MainArena);
+        return ptr;
     }
 
     if (!size) {
         free(ptr);
+        arena_unlock(&MainArena);
+        return NULL;
+    }
+
+    // Leave memory that is not ours alone (its size is unknown)
+    if (foreign_pointer(ptr)) {
+        arena_unlock(&MainArena);
+        errno = EINVAL;
         return NULL;
     }
 
     Block *block = BLOCK_FROM_POINTER(ptr);
 
+    // Let the kernel move the pages of a block with a mapping of its own
+    Site  *site    = SitesEnabled ? sites_free(block) : NULL;
+    Block *resized = block_resize(block, size);
+    if (resized) {
+        if (site) {
+            sites_tag(resized, site);
+        }
+
+        if (ProfileLive && resized != block) {
+            profile_move(ptr, resized->data);
+        }
+
+        Counters[REQUESTED] += size;
+        stats_publish();
+        arena_unlock(&MainArena);
+        return resized->data;
+    }
+
+    if (site) {
+        sites_tag(block, site);
+    }
+
     void *new_ptr;
-    new_ptr = malloc(size);
+    CallSite = __builtin_return_address(0);
+    new_ptr  = malloc(size);
+    CallSite = NULL;
+    arena_unlock(&MainArena);
 
+    // Leave the old block alone (malloc set errno)
     if (!new_ptr) {
-        return NULL; // TODO: set errno on failure.
+        return NULL;
     }
 
-    memcpy(new_ptr, ptr, block->size);
+    // Copy the whole usable capacity (see malloc_usable_size) that fits
+    memcpy(new_ptr, ptr, block->capacity < size ? block->capacity : size);
     free(ptr);
     return new_ptr;
 }
 
+/**
+ * Allocate the specified number of blocks of the same size:
+ *
+ *  1. Find (or allocate) one block that fits the whole remaining run.
+ *  2. Carve it into contiguous blocks.
+ *  3. If no such block is available, retry with half the run.
+ *
+ * @param   size    Amount of bytes to allocate for each block.
+ * @param   n       Number of blocks to allocate.
+ * @param   ptrs    Array to store the pointers to the allocated memory in.
+ * @return  Number of pointers stored at the front of ptrs (less than n if the
+ * heap could not grow).
+ **/
+size_t malloc_bulk(size_t size, size_t n, void **ptrs) {
+    arena_lock(&MainArena);
+    init_counters();
+    arena_collect(&MainArena);
+
+    // Round up to the size class like malloc (see size_class)
+    size = size_class(size);
+
+    size_t count  = 0;
+    size_t stride = sizeof(Block) + ALIGN(size);
+    size_t run    = size && stride > size ? n : 0;
+    bool   buddy  = run && BuddyEnabled && size <= BUDDY_MAX_CAPACITY;
+
+    // Buddy blocks cannot be carved, so take them one at a time
+    if (buddy) {
+        run = 1;
+    }
+
+    while (count < n && run) {
+        if (run > n - count) {
+            run = n - count;
+        }
+
+        if (run > (SIZE_MAX - sizeof(Block)) / stride) {
+            run = (SIZE_MAX - sizeof(Block)) / stride;
+        }
+
+        size_t total = buddy ? size : run * stride - sizeof(Block);
+        Block *block = free_list_search(total);
+        if (block) {
+            block = free_list_take(block, total);
+        } else {
+            block = block_allocate(total);
+        }
+
+        if (!block) {
+            run /= 2;
+            continue;
+        }
+
+        Block **blocks = (Block **)(ptrs + count);
+        size_t  carved = 1;
+        if (buddy_owns(block)) {
+            blocks[0] = block;
+        } else {
+            carved = block_carve(block, size, blocks, n - count);
+        }
+        for (size_t i = 0; i < carved; i++) {
+            Block *curr = blocks[i];
+
+            if (ProfileEnabled) {
+                profile_malloc(curr->data, size);
+            }
+
+            if (SitesEnabled) {
+                sites_malloc(curr, __builtin_return_address(0), 0, 0);
+            }
+
+            ptrs[count + i] = curr->data;
+        }
+
+        Counters[BULK_RUNS]++;
+        count += carved;
+    }
+
+    Counters[BULK_MALLOCS] += count;
+    Counters[REQUESTED]    += count * size;
+    stats_publish();
+    arena_unlock(&MainArena);
+    return count;
+}
+
+/**
+ * Release the specified previously allocated memory in a single pass:
+ *
+ *  1. Sort the blocks by address and merge the adjacent ones.
+ *  2. Release (or insert into the free list) each coalesced block.
+ *
+ * Note, the contents of ptrs are overwritten (it is used as scratch space
+ * for the blocks).
+ *
+ * @param   n       Number of pointers.
+ * @param   ptrs    Array of pointers to previously allocated memory (NULL
+ * pointers and pointers that are not ours are ignored).
+ **/
+void free_bulk(size_t n, void **ptrs) {
+    Block **blocks = (Block **)ptrs;
+    size_t  count  = 0;
+
+    arena_lock(&MainArena);
+    for (size_t i = 0; i < n; i++) {
+        if (!ptrs[i] || foreign_pointer(ptrs[i])) {
+            continue;
+        }
+
+        if (ProfileLive) {
+            profile_free(ptrs[i]);
+        }
+
+        Block *block = BLOCK_FROM_POINTER(ptrs[i]);
+        if (SitesEnabled) {
+            sites_free(block);
+        }
+
+        blocks[count++] = block;
+    }
+
+    Counters[BULK_FREES] += count;
+
+    // Buddy blocks are merged with their buddies by free_list_insert instead
+    if (!BuddyEnabled) {
+        count = block_coalesce(blocks, count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!block_release(blocks[i])) {
+            free_list_insert(blocks[i]);
+        }
+    }
+
+    stats_publish();
+    arena_unlock(&MainArena);
+}
+
+/**
+ * Allocate specified amount of memory aligned to the specified alignment:
+ *
+ *  1. Allocate enough memory to fit the aligned data and a header in front.
+ *  2. Split off the misaligned prefix and return it to the free list.
+ *  3. Split off any excess after the aligned data and return it as well.
+ *
+ * Note, a block of the buddy system is aligned within instead (see
+ * buddy_align).  Either way, this requires the MainArena lock.
+ *
+ * @param   alignment   Alignment of the memory (power of two).
+ * @param   size        Amount of bytes to allocate.
+ * @param   caller      Call site to attribute the allocation to.
+ * @return  Pointer to the requested amount of aligned memory.
+ **/
+static void *aligned_malloc(size_t alignment, size_t size, void *caller) {
+    if (!alignment || (alignment & (alignment - 1))) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (alignment <= ALIGNMENT) {
+        CallSite  = caller;
+        void *ptr = malloc(size);
+        CallSite  = NULL;
+        return ptr;
+    }
+
+    // Round up to the size class like malloc (see size_class)
+    init_counters();
+    size = size_class(size);
+
+    size_t padding = alignment + sizeof(Block) + ALIGNMENT;
+    if (size > SIZE_MAX - padding) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // Buddy blocks are aligned to their size, so ask for one to align within
+    if (BuddyEnabled && size + padding <= BUDDY_MAX_CAPACITY) {
+        padding = buddy_padding(alignment, size);
+    }
+
+    CallSite  = caller;
+    void *ptr = malloc(size + padding);
+    CallSite  = NULL;
+    if (!ptr) {
+        return NULL;
+    }
+
+    // Untag the block from its call site until it is aligned
+    Block *block = BLOCK_FROM_POINTER(ptr);
+    Site  *site  = SitesEnabled ? sites_free(block) : NULL;
+
+    // Count the padding first if a per-CPU cache served the block
+    if (PerCpuEnabled) {
+        percpu_collect();
+    }
+    Counters[REQUESTED] -= padding;
+
+    Block *aligned = NULL;
+    if (buddy_owns(block)) {
+        // Move the header in front of the aligned data within the buddy block
+        aligned = buddy_align(block, alignment, size);
+    } else {
+        // Return misaligned prefix to the free list
+        block->size = size;
+        aligned     = block_align(block, alignment);
+        if (!aligned) {
+            // Only when the buddy system ran out of memory is the padding short
+            free(ptr);
+            errno = ENOMEM;
+            return NULL;
+        }
+        if (aligned != block) {
+            free_list_insert(block);
+        }
+
+        // Return excess after the aligned data to the heap
+        aligned = block_split(aligned, size);
+        if (aligned->next != aligned) {
+            Block *excess = aligned->next;
+            block_detach(aligned);
+            if (!block_release(excess)) {
+                free_list_insert(excess);
+            }
+        }
+    }
+
+    if (ProfileLive && aligned->data != ptr) {
+        profile_move(ptr, aligned->data);
+    }
+
+    if (site) {
+        site->bytes -= padding;
+        sites_tag(aligned, site);
+    }
+
+    stats_publish();
+    return aligned->data;
+}
+
+/**
+ * Allocate specified amount of memory aligned to the specified alignment.
+ * @param   alignment   Alignment of the memory (power of two).
+ * @param   size        Amount of bytes to allocate.
+ * @return  Pointer to the requested amount of aligned memory.
+ **/
+void *memalign(size_t alignment, size_t size) {
+    arena_lock(&MainArena);
+    void *ptr = aligned_malloc(alignment, size, __builtin_return_address(0));
+    arena_unlock(&MainArena);
+    return ptr;
+}
+
+/**
+ * Allocate specified amount of memory aligned to the specified alignment.
+ * @param   memptr      Where to store the pointer to the aligned memory.
+ * @param   alignment   Alignment of the memory (power of two multiple of
+ * sizeof(void *)).
+ * @param   size        Amount of bytes to allocate.
+ * @return  0 on success, otherwise EINVAL or ENOMEM.
+ **/
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    if (!alignment || alignment % sizeof(void *) || (alignment & (alignment - 1))) {
+        return EINVAL;
+    }
+
+    arena_lock(&MainArena);
+    void *ptr = aligned_malloc(alignment, size, __builtin_return_address(0));
+    arena_unlock(&MainArena);
+    if (!ptr && size) {
+        return ENOMEM;
+    }
+
+    *memptr = ptr;
+    return 0;
+}
+
+/**
+ * Allocate specified amount of memory aligned to the specified alignment.
+ * @param   alignment   Alignment of the memory (power of two).
+ * @param   size        Amount of bytes to allocate.
+ * @return  Pointer to the requested amount of aligned memory.
+ **/
+void *aligned_alloc(size_t alignment, size_t size) {
+    arena_lock(&MainArena);
+    void *ptr = aligned_malloc(alignment, size, __builtin_return_address(0));
+    arena_unlock(&MainArena);
+    return ptr;
+}
+
+/**
+ * Allocate specified amount of memory aligned to the page size.
+ * @param   size        Amount of bytes to allocate.
+ * @return  Pointer to the requested amount of page-aligned memory.
+ **/
+void *valloc(size_t size) {
+    arena_lock(&MainArena);
+    void *ptr = aligned_malloc(sysconf(_SC_PAGESIZE), size, __builtin_return_address(0));
+    arena_unlock(&MainArena);
+    return ptr;
+}
+
+/**
+ * Allocate specified amount of memory (rounded up to a whole number of pages)
+ * aligned to the page size.
+ * @param   size        Amount of bytes to allocate.
+ * @return  Pointer to the requested amount of page-aligned memory.
+ **/
+void *pvalloc(size_t size) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    arena_lock(&MainArena);
+    void *ptr = aligned_malloc(page_size, (size + page_size - 1) & ~(page_size - 1), __builtin_return_address(0));
+    arena_unlock(&MainArena);
+    return ptr;
+}
+
+/**
+ * Return number of usable bytes in previously allocated memory.
+ *
+ * Note, the caller may use the whole capacity of the block, not just the size
+ * originally requested.
+ *
+ * @param   ptr     Pointer to previously allocated memory.
+ * @return  Number of usable bytes (otherwise 0 if ptr is NULL or not ours).
+ **/
+size_t malloc_usable_size(void *ptr) {
+    if (!ptr || foreign_pointer(ptr)) {
+        return 0;
+    }
+
+    Block *block = BLOCK_FROM_POINTER(ptr);
+    return block->capacity;
+}
+
+/**
+ * Return summary of heap usage computed from the counters and free list:
+ *
+ *  - arena:    Size of the heap (including block headers).
+ *  - ordblks:  Number of blocks in the free list (and free buddy blocks).
+ *  - smblks:   Number of blocks in the fast bins and per-CPU caches.
+ *  - fsmblks:  Capacity of all blocks in the fast bins and per-CPU caches.
+ *  - fordblks: Capacity of all free blocks (including smblks).
+ *  - uordblks: Everything in the heap that is not free.
+ *  - keepcost: Capacity of the free block at the end of the heap.
+ *
+ * @return  Heap usage summary.
+ **/
+struct mallinfo2 mallinfo2() {
+    struct mallinfo2 info = {0};
+    arena_lock(&MainArena);
+
+    for (Block *curr = FreeList.next; curr != &FreeList; curr = curr->next) {
+        info.ordblks++;
+        info.fordblks += curr->capacity;
+        if (block_at_top(curr)) {
+            info.keepcost = curr->capacity;
+        }
+    }
+
+    info.ordblks  += buddy_length();
+    info.fordblks += buddy_bytes();
+    info.smblks    = fastbins_length() + percpu_length();
+    info.fsmblks   = fastbins_bytes() + percpu_bytes();
+    info.fordblks += info.fsmblks;
+
+    info.arena    = Counters[HEAP_SIZE];
+    info.uordblks = info.arena - info.fordblks;
+    arena_unlock(&MainArena);
+    return info;
+}
+
+/**
+ * Return summary of heap usage (truncated to int; see mallinfo2).
+ * @return  Heap usage summary.
+ **/
+struct mallinfo mallinfo() {
+    struct mallinfo2 info2 = mallinfo2();
+    struct mallinfo  info  = {
+        .arena    = info2.arena,
+        .ordblks  = info2.ordblks,
+        .smblks   = info2.smblks,
+        .fsmblks  = info2.fsmblks,
+        .uordblks = info2.uordblks,
+        .fordblks = info2.fordblks,
+        .keepcost = info2.keepcost,
+    };
+    return info;
+}
+
+/**
+ * Display heap usage summary to standard error.
+ **/
+void malloc_stats() {
+    char buffer[BUFSIZ];
+    struct mallinfo2 info = mallinfo2();
+
+    fdprintf(STDERR_FILENO, buffer, "Arena 0:\n");
+    fdprintf(STDERR_FILENO, buffer, "system bytes     = %10lu\n", info.arena);
+    fdprintf(STDERR_FILENO, buffer, "in use bytes     = %10lu\n", info.uordblks);
+    fdprintf(STDERR_FILENO, buffer, "Total (incl. mmap):\n");
+    fdprintf(STDERR_FILENO, buffer, "system bytes     = %10lu\n", info.arena);
+    fdprintf(STDERR_FILENO, buffer, "in use bytes     = %10lu\n", info.uordblks);
+    fdprintf(STDERR_FILENO, buffer, "max mmap regions = %10d\n" , 0);
+    fdprintf(STDERR_FILENO, buffer, "max mmap bytes   = %10d\n" , 0);
+}
+
 /* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,371 @@
+/* profile.c: Sampling Heap Profiler
+ *
+ * When the MALLOC_PROFILE environment variable is set, allocations are
+ * sampled on average once every PROFILE_RATE bytes (geometric sampling, so
+ * that every byte has the same chance of triggering a sample).  For each
+ * sample, the backtrace of the caller is recorded in an open addressing table
+ * keyed by the sampled pointer, and the sample is removed when the pointer is
+ * freed.
+ *
+ * The frames of the backtrace that are inside the library (whichever entry
+ * point it went through, e.g. calloc or posix_memalign) are left out, so a
+ * sample is attributed to the code that called the allocator.  When the
+ * library is linked into the program rather than loaded as a shared object,
+ * its text cannot be told apart, so PROFILE_SKIP frames are left out instead.
+ *
+ * The live samples are written as a heap profile in the legacy gperftools
+ * format (heap_v2), which pprof understands, when the process exits, when
+ * profile_dump is called, or when the signal in MALLOC_PROFILE_SIGNAL is
+ * received.
+ **/
+
+#define _GNU_SOURCE     /* For dl_iterate_phdr */
+
+#include "malloc/arena.h"
+#include "malloc/counters.h"
+#include "malloc/profile.h"
+
+#include <execinfo.h>
+#include <fcntl.h>
+#include <link.h>
+#include <math.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Global Variables */
+
+bool    ProfileEnabled   = false;
+size_t  ProfileLive      = 0;
+
+static Sample *                 ProfileTable     = NULL;
+static char *                   ProfilePath      = NULL;
+static size_t                   ProfileRate      = PROFILE_RATE;
+static ssize_t                  ProfileCountdown = 0;
+static uint64_t                 ProfileSeed      = 0;
+static size_t                   ProfileSampled   = 0;
+static size_t                   ProfileBytes     = 0;
+static size_t                   ProfileDumps     = 0;
+static bool                     ProfileBusy      = false;
+static volatile sig_atomic_t    ProfileRequested = 0;
+static uintptr_t                ProfileTextStart = 0;   /* Text of library */
+static uintptr_t                ProfileTextEnd   = 0;
+
+/* Functions */
+
+/**
+ * Compute the table slot for the specified pointer.
+ **/
+static size_t profile_slot(void *ptr) {
+    return (((uintptr_t)ptr >> 3) * 0x9E3779B97F4A7C15UL >> 32) & (PROFILE_SLOTS - 1);
+}
+
+/**
+ * Compute the number of bytes until the next sample by drawing from an
+ * exponential distribution with a mean of ProfileRate bytes.
+ **/
+static ssize_t profile_interval() {
+    ProfileSeed ^= ProfileSeed << 13;
+    ProfileSeed ^= ProfileSeed >> 7;
+    ProfileSeed ^= ProfileSeed << 17;
+
+    double uniform = ((ProfileSeed >> 11) + 1) / (double)(1UL << 53);
+    return (ssize_t)(-log(uniform) * ProfileRate) + 1;
+}
+
+/**
+ * Record the executable segment of the shared object that holds the profiler
+ * (called by dl_iterate_phdr for every loaded object).
+ * @param   info    Program headers of the object.
+ * @param   size    Size of info.
+ * @param   data    Unused.
+ * @return  Whether or not the object was found (which stops the iteration).
+ **/
+static int profile_text(struct dl_phdr_info *info, size_t size, void *data) {
+    uintptr_t self = (uintptr_t)profile_malloc;
+
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr) *phdr  = &info->dlpi_phdr[i];
+        uintptr_t         start = info->dlpi_addr + phdr->p_vaddr;
+        if (phdr->p_type != PT_LOAD || !(phdr->p_flags & PF_X) || self < start || self >= start + phdr->p_memsz) {
+            continue;
+        }
+
+        // The text of the program holds its own frames too
+        if (info->dlpi_name && *info->dlpi_name) {
+            ProfileTextStart = start;
+            ProfileTextEnd   = start + phdr->p_memsz;
+        }
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Count the frames at the top of the specified backtrace that are inside the
+ * library.
+ * @param   stack   Backtrace.
+ * @param   depth   Number of frames in backtrace.
+ * @return  Number of frames to leave out.
+ **/
+static int profile_skip(void **stack, int depth) {
+    if (!ProfileTextEnd) {
+        return depth < PROFILE_SKIP ? depth : PROFILE_SKIP;
+    }
+
+    int skip = 0;
+    while (skip < depth && (uintptr_t)stack[skip] >= ProfileTextStart && (uintptr_t)stack[skip] < ProfileTextEnd) {
+        skip++;
+    }
+    return skip;
+}
+
+/**
+ * Record that a profile was requested by a signal (it is written by the next
+ * malloc, since the heap may be in use when the signal arrives).
+ **/
+static void profile_signal(int signum) {
+    ProfileRequested = 1;
+}
+
+/**
+ * Write the exit profile to the path specified by PROFILE_ENV (holding the
+ * MainArena lock, since other threads may still allocate).
+ **/
+static void profile_exit() {
+    if (ProfilePath) {
+        arena_lock(&MainArena);
+        profile_dump(ProfilePath);
+        arena_unlock(&MainArena);
+    }
+}
+
+/**
+ * Initialize the profiler if the PROFILE_ENV environment variable is set:
+ *
+ *  1. Map the sample table.
+ *  2. Read the sampling rate and dump signal (if any).
+ *  3. Find the text of the library (see profile_skip).
+ *  4. Register profile_exit to run when the program terminates.
+ *
+ * Note, this should only be called once (from init_counters).
+ **/
+void    profile_init() {
+    char *path = getenv(PROFILE_ENV);
+    if (!path || !*path) {
+        return;
+    }
+
+    Sample *table = mmap(NULL, PROFILE_SLOTS * sizeof(Sample), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (table == MAP_FAILED) {
+        return;
+    }
+
+    char *rate = getenv(PROFILE_RATE_ENV);
+    if (rate && strtoul(rate, NULL, 10)) {
+        ProfileRate = strtoul(rate, NULL, 10);
+    }
+
+    char *signum = getenv(PROFILE_SIGNAL_ENV);
+    if (signum && atoi(signum) > 0) {
+        struct sigaction action = {.sa_handler = profile_signal, .sa_flags = SA_RESTART};
+        sigaction(atoi(signum), &action, NULL);
+    }
+
+    // Resolve backtrace now since its first call may allocate memory
+    void *stack[PROFILE_DEPTH];
+    ProfileBusy = true;
+    backtrace(stack, PROFILE_DEPTH);
+    ProfileBusy = false;
+
+    dl_iterate_phdr(profile_text, NULL);
+
+    ProfileTable     = table;
+    ProfilePath      = path;
+    ProfileSeed      = ((uint64_t)getpid() << 32) ^ (uintptr_t)table ^ 0x2545F4914F6CDD1DUL;
+    ProfileCountdown = profile_interval();
+    ProfileEnabled   = true;
+    atexit(profile_exit);
+}
+
+/**
+ * Account for an allocation and sample it if the sampling interval elapsed.
+ * @param   ptr     Pointer to allocated memory.
+ * @param   size    Number of bytes requested.
+ **/
+void    profile_malloc(void *ptr, size_t size) {
+    if (ProfileBusy) {
+        return;
+    }
+
+    if (ProfileRequested) {
+        char path[BUFSIZ];
+        ProfileRequested = 0;
+        sprintf(path, "%s.%04lu", ProfilePath, ProfileDumps);
+        profile_dump(path);
+    }
+
+    ProfileCountdown -= size;
+    if (ProfileCountdown > 0) {
+        return;
+    }
+    ProfileCountdown = profile_interval();
+
+    ProfileSampled++;
+    ProfileBytes += size;
+    if (ProfileLive >= PROFILE_SAMPLES) {
+        return;
+    }
+
+    size_t slot = profile_slot(ptr);
+    while (ProfileTable[slot].ptr) {
+        slot = (slot + 1) & (PROFILE_SLOTS - 1);
+    }
+
+    void *stack[PROFILE_DEPTH + PROFILE_INNER];
+    ProfileBusy = true;
+    int depth = backtrace(stack, PROFILE_DEPTH + PROFILE_INNER);
+    ProfileBusy = false;
+
+    int skip = profile_skip(stack, depth);
+    depth -= skip;
+
+    Sample *sample = &ProfileTable[slot];
+    sample->ptr    = ptr;
+    sample->size   = size;
+    sample->depth  = depth < PROFILE_DEPTH ? depth : PROFILE_DEPTH;
+    memcpy(sample->stack, stack + skip, sample->depth * sizeof(void *));
+    ProfileLive++;
+}
+
+/**
+ * Find the slot of the sample for the specified pointer.
+ * @return  Slot of sample (otherwise PROFILE_SLOTS if it was not sampled).
+ **/
+static size_t profile_find(void *ptr) {
+    if (!ProfileLive) {
+        return PROFILE_SLOTS;
+    }
+
+    for (size_t slot = profile_slot(ptr); ProfileTable[slot].ptr; slot = (slot + 1) & (PROFILE_SLOTS - 1)) {
+        if (ProfileTable[slot].ptr == ptr) {
+            return slot;
+        }
+    }
+
+    return PROFILE_SLOTS;
+}
+
+/**
+ * Remove the sample for the specified pointer (if any).
+ *
+ * Note, the following samples in the probe sequence are shifted back so that
+ * no tombstones are needed.
+ *
+ * @param   ptr     Pointer to memory being freed.
+ **/
+void    profile_free(void *ptr) {
+    size_t hole = profile_find(ptr);
+    if (hole == PROFILE_SLOTS) {
+        return;
+    }
+
+    ProfileTable[hole].ptr = NULL;
+    ProfileLive--;
+
+    for (size_t slot = (hole + 1) & (PROFILE_SLOTS - 1); ProfileTable[slot].ptr; slot = (slot + 1) & (PROFILE_SLOTS - 1)) {
+        size_t home = profile_slot(ProfileTable[slot].ptr);
+        bool   stay = hole <= slot ? (hole < home && home <= slot) : (hole < home || home <= slot);
+        if (!stay) {
+            ProfileTable[hole]     = ProfileTable[slot];
+            ProfileTable[slot].ptr = NULL;
+            hole = slot;
+        }
+    }
+}
+
+/**
+ * Update the sample of an allocation whose data moved (e.g. when aligned).
+ * @param   from    Original pointer to the allocation.
+ * @param   to      New pointer to the allocation.
+ **/
+void    profile_move(void *from, void *to) {
+    size_t slot = profile_find(from);
+    if (slot == PROFILE_SLOTS) {
+        return;
+    }
+
+    Sample sample = ProfileTable[slot];
+    profile_free(from);
+
+    for (slot = profile_slot(to); ProfileTable[slot].ptr; slot = (slot + 1) & (PROFILE_SLOTS - 1));
+    sample.ptr = to;
+    ProfileTable[slot] = sample;
+    ProfileLive++;
+}
+
+/**
+ * Write the live samples as a heap profile (heap_v2 format) to the specified
+ * path, followed by the memory mappings of the process so that pprof can
+ * symbolize the stacks.
+ * @param   path    Path of the heap profile.
+ * @return  Whether or not the profile was written successfully.
+ **/
+bool    profile_dump(const char *path) {
+    if (!ProfileTable) {
+        return false;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    char   buffer[BUFSIZ];
+    size_t live_bytes = 0;
+
+    ProfileBusy = true;
+    for (size_t slot = 0; slot < PROFILE_SLOTS; slot++) {
+        if (ProfileTable[slot].ptr) {
+            live_bytes += ProfileTable[slot].size;
+        }
+    }
+
+    fdprintf(fd, buffer, "heap profile: %6lu: %8lu [%6lu: %8lu] @ heap_v2/%lu\n",
+        ProfileLive, live_bytes, ProfileSampled, ProfileBytes, ProfileRate);
+
+    for (size_t slot = 0; slot < PROFILE_SLOTS; slot++) {
+        Sample *sample = &ProfileTable[slot];
+        if (!sample->ptr) {
+            continue;
+        }
+
+        fdprintf(fd, buffer, "%6d: %8lu [%6d: %8lu] @", 1, sample->size, 1, sample->size);
+        for (int frame = 0; frame < sample->depth; frame++) {
+            fdprintf(fd, buffer, " %p", sample->stack[frame]);
+        }
+        fdprintf(fd, buffer, "\n");
+    }
+
+    fdprintf(fd, buffer, "\nMAPPED_LIBRARIES:\n");
+    int maps = open("/proc/self/maps", O_RDONLY);
+    if (maps >= 0) {
+        ssize_t nread;
+        while ((nread = read(maps, buffer, BUFSIZ)) > 0) {
+            if (write(fd, buffer, nread) != nread) {
+                break;
+            }
+        }
+        close(maps);
+    }
+
+    ProfileBusy = false;
+    ProfileDumps++;
+    close(fd);
+    return true;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,186 @@
+/* region.c: Regions
+ *
+ * A region bump-allocates memory from chunks that are taken from the free
+ * list (or the heap) and frees all of it at once with region_reset or
+ * region_destroy, so that objects that die together are never freed (and
+ * merged) one by one.
+ *
+ * The region itself lives at the start of its first chunk, which is kept by
+ * region_reset.  Allocations larger than REGION_LARGE get a chunk of their
+ * own (so they do not waste the rest of the current chunk).
+ *
+ * Only taking and giving back chunks requires the MainArena lock, so a region
+ * must not be used by more than one thread at a time.  Its usage is added to
+ * the counters whenever it takes a chunk or is reset.
+ **/
+
+#include "malloc/arena.h"
+#include "malloc/counters.h"
+#include "malloc/freelist.h"
+#include "malloc/region.h"
+
+/* Functions */
+
+/**
+ * Take a chunk with at least the specified capacity from the free list
+ * (otherwise from the heap).
+ *
+ * Note, this requires the MainArena lock.
+ *
+ * @param   size    Amount of memory required.
+ * @return  Pointer to detached block (otherwise NULL).
+ **/
+static Block *region_chunk(size_t size) {
+    Block *block = free_list_search(size);
+
+    block = block ? free_list_take(block, size) : block_allocate(size);
+    if (block) {
+        Counters[REGION_CHUNKS]++;
+    }
+    return block;
+}
+
+/**
+ * Give the specified chunks back to the heap (or the free list).
+ *
+ * Note, this requires the MainArena lock.
+ *
+ * @param   block   First chunk of NULL-terminated list linked through next.
+ **/
+static void region_release(Block *block) {
+    while (block) {
+        Block *next = block->next;
+        block->next = block;
+
+        if (!block_release(block)) {
+            free_list_insert(block);
+        }
+        block = next;
+    }
+}
+
+/**
+ * Add the usage of the region since the last flush to the counters.
+ *
+ * Note, this requires the MainArena lock.
+ *
+ * @param   region  Pointer to region.
+ **/
+static void region_flush(Region *region) {
+    Counters[REGION_ALLOCS] += region->allocs;
+    Counters[REGION_BYTES]  += region->bytes;
+    region->allocs = 0;
+    region->bytes  = 0;
+}
+
+/**
+ * Create a region in a new chunk.
+ * @return  Pointer to region (otherwise NULL if no memory is available).
+ **/
+Region *region_create() {
+    arena_lock(&MainArena);
+    init_counters();
+
+    Block *block = region_chunk(REGION_CHUNK);
+    arena_unlock(&MainArena);
+    if (!block) {
+        return NULL;
+    }
+
+    Region *region = (Region *)block->data;
+    region->first  = block;
+    region->chunks = NULL;
+    region->cursor = block->data + ALIGN(sizeof(Region));
+    region->end    = block->data + block->capacity;
+    region->allocs = 0;
+    region->bytes  = 0;
+    return region;
+}
+
+/**
+ * Allocate specified amount of memory from the region:
+ *
+ *  1. Bump the cursor of the current chunk if the memory fits.
+ *  2. Otherwise, take a chunk just for the memory if it is large.
+ *  3. Otherwise, take a new current chunk.
+ *
+ * @param   region  Pointer to region.
+ * @param   size    Amount of bytes to allocate.
+ * @return  Pointer to memory (otherwise NULL if size is 0 or no memory is
+ * available).
+ **/
+void *  region_alloc(Region *region, size_t size) {
+    if (!size || size > SIZE_MAX - REGION_CHUNK) {
+        return NULL;
+    }
+
+    size_t aligned = ALIGN(size);
+    char * data    = region->cursor;
+
+    if (aligned > (size_t)(region->end - region->cursor)) {
+        arena_lock(&MainArena);
+        region_flush(region);
+
+        Block *block = region_chunk(aligned > REGION_LARGE ? aligned : REGION_CHUNK);
+        arena_unlock(&MainArena);
+        if (!block) {
+            return NULL;
+        }
+
+        block->next    = region->chunks;
+        region->chunks = block;
+        data           = block->data;
+
+        if (aligned > REGION_LARGE) {
+            region->allocs++;
+            region->bytes += size;
+            return data;
+        }
+
+        region->end = block->data + block->capacity;
+    }
+
+    region->cursor = data + aligned;
+    region->allocs++;
+    region->bytes += size;
+    return data;
+}
+
+/**
+ * Free all the memory allocated from the region at once (keeping only the
+ * chunk that holds the region).
+ * @param   region  Pointer to region.
+ **/
+void    region_reset(Region *region) {
+    arena_lock(&MainArena);
+    region_flush(region);
+    region_release(region->chunks);
+    Counters[REGION_RESETS]++;
+    arena_unlock(&MainArena);
+
+    region->chunks = NULL;
+    region->cursor = region->first->data + ALIGN(sizeof(Region));
+    region->end    = region->first->data + region->first->capacity;
+}
+
+/**
+ * Free all the memory allocated from the region and the region itself.
+ * @param   region  Pointer to region.
+ **/
+void    region_destroy(Region *region) {
+    if (!region) {
+        return;
+    }
+
+    Block *first = region->first;
+    first->next  = NULL;
+
+    arena_lock(&MainArena);
+    region_flush(region);
+    region_release(region->chunks);
+    region_release(first);
+    Counters[REGION_RESETS]++;
+    arena_unlock(&MainArena);
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
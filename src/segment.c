@@ -0,0 +1,343 @@
+/* segment.c: Segmented Heap
+ *
+ * When SEGMENTS_ENV is set, the heap is made of independently mapped segments
+ * of that many MiB (clamped to SEGMENT_MIN and SEGMENT_MAX) instead of one
+ * contiguous region, so that a live block only pins its own segment:
+ *
+ *  1. Blocks are carved from the top of the current segment, and a new current
+ *     segment is mapped when a block does not fit in what is left of it.
+ *  2. Blocks larger than 1/SEGMENT_LARGE of a segment get a segment of their
+ *     own (which is unmapped as soon as the block is released).
+ *  3. The free list adds (and subtracts) the blocks of a segment that enter
+ *     (and leave) it, and once every block of a segment is free, they are
+ *     taken out of the free list and the segment is unmapped.
+ *
+ * The current segment is never unmapped (only its top is lowered like the
+ * program break), so that a program that keeps allocating and freeing the same
+ * block does not map and unmap a segment every time.  Every segment starts
+ * with a SEGMENT_GUARD gap, so that blocks never merge across segments that
+ * happen to be mapped next to each other.
+ *
+ * The segments are kept in a table sorted by address, so the segment of a
+ * block is found with a binary search.  A block with a segment of its own is
+ * resized by remapping the segment (which may move it in the table).
+ **/
+
+#define _GNU_SOURCE     /* For mremap */
+
+#include "malloc/counters.h"
+#include "malloc/freelist.h"
+#include "malloc/pagemap.h"
+#include "malloc/segment.h"
+
+#include <string.h>
+#include <sys/mman.h>
+
+/* Global Variables */
+
+bool            SegmentsEnabled = false;
+static size_t   SegmentSize     = 0;
+static char *   SegmentCurrent  = NULL;         /* Start of current segment */
+static size_t   SegmentsCount   = 0;
+static Segment  Segments[SEGMENTS_MAX];         /* Sorted by start */
+
+/* Functions */
+
+/**
+ * Enable segments if the SEGMENTS_ENV environment variable is set to a
+ * positive number of MiB.
+ *
+ * Note, this should only be called once (from block_init).
+ **/
+void    segment_init() {
+    char *size = getenv(SEGMENTS_ENV);
+    if (!size || atol(size) <= 0) {
+        return;
+    }
+
+    SegmentSize     = (size_t)atol(size) < SEGMENT_MAX / SEGMENT_MIN ? (size_t)atol(size) * SEGMENT_MIN : SEGMENT_MAX;
+    SegmentsEnabled = true;
+}
+
+/**
+ * Return the number of segments that start at or below the specified address.
+ **/
+static size_t segment_index(const void *address) {
+    size_t low  = 0;
+    size_t high = SegmentsCount;
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (Segments[middle].start <= (char *)address) {
+            low  = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/**
+ * Find the segment that contains the specified address.
+ * @param   address     Address of block (or anything else in the heap).
+ * @return  Pointer to segment (otherwise NULL).
+ **/
+Segment *segment_find(const void *address) {
+    size_t index = segment_index(address);
+    if (!index) {
+        return NULL;
+    }
+
+    Segment *segment = &Segments[index - 1];
+    return (char *)address < segment->start + segment->length ? segment : NULL;
+}
+
+/**
+ * Map a new segment with room for at least the specified number of bytes.
+ *
+ * Note, this moves the segments above it in the table.
+ *
+ * @param   size    Number of bytes of blocks the segment must hold.
+ * @return  Pointer to segment (otherwise NULL).
+ **/
+static Segment *segment_map(size_t size) {
+    size_t length = PAGE_ALIGN(SEGMENT_GUARD + size);
+    if (length < size || SegmentsCount == SEGMENTS_MAX) {
+        return NULL;
+    }
+
+    char *start = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (start == MAP_FAILED) {
+        return NULL;
+    }
+
+    size_t   index   = segment_index(start);
+    Segment *segment = &Segments[index];
+    memmove(segment + 1, segment, (SegmentsCount - index) * sizeof(Segment));
+    SegmentsCount++;
+
+    segment->start  = start;
+    segment->top    = start + SEGMENT_GUARD;
+    segment->length = length;
+    segment->free   = 0;
+
+    Counters[SEGMENT_MAPS]++;
+    Counters[SEGMENT_BYTES] += length;
+    return segment;
+}
+
+/**
+ * Unmap the specified segment, taking its blocks out of the free list first
+ * (unless its only block is the detached one being released).
+ *
+ * Note, this moves the segments above it in the table.
+ *
+ * @param   segment Pointer to segment whose blocks are all free.
+ **/
+static void segment_unmap(Segment *segment) {
+    char *first  = segment->start + SEGMENT_GUARD;
+    bool  listed = segment->free > 0;
+
+    for (char *curr = first; curr < segment->top; ) {
+        Block *block = (Block *)curr;
+        curr = block->data + block->capacity;
+
+        if (listed) {
+            free_list_take(block, block->capacity);
+        }
+        Counters[BLOCKS]--;
+    }
+
+    munmap(segment->start, segment->length);
+    pagemap_clear(segment->start, segment->length);
+
+    Counters[HEAP_SIZE]     -= segment->top - first;
+    Counters[SEGMENT_BYTES] -= segment->length;
+    Counters[SEGMENT_UNMAPS]++;
+    Counters[SHRINKS]++;
+
+    SegmentsCount--;
+    memmove(segment, segment + 1, (SegmentsCount - (segment - Segments)) * sizeof(Segment));
+}
+
+/**
+ * Carve a block from the current segment (or a segment of its own if it is
+ * large), mapping a new segment when needed.
+ *
+ * Note, the previous current segment is unmapped right away if all of its
+ * blocks are already free.
+ *
+ * @param   allocated   Number of bytes to allocate (including the header).
+ * @return  Pointer to carved block (otherwise SBRK_FAILURE).
+ **/
+Block * segment_allocate(size_t allocated) {
+    Segment *segment = allocated > SegmentSize / SEGMENT_LARGE ? NULL : segment_find(SegmentCurrent);
+
+    if (!segment || allocated > (size_t)(segment->start + segment->length - segment->top)) {
+        char *previous = SegmentCurrent;
+
+        segment = segment_map(allocated > SegmentSize / SEGMENT_LARGE ? allocated : SegmentSize);
+        if (!segment) {
+            return SBRK_FAILURE;
+        }
+
+        if (allocated <= SegmentSize / SEGMENT_LARGE) {
+            char *start    = segment->start;
+            SegmentCurrent = start;
+            segment_free(segment_find(previous), 0);
+            segment        = segment_find(start);
+        }
+    }
+
+    Block *block  = (Block *)segment->top;
+    segment->top += allocated;
+    return block;
+}
+
+/**
+ * Attempt to give the memory of a detached block back:
+ *
+ *  1. If the block is the only block of a segment (other than the current
+ *  one), then unmap the segment.
+ *  2. If the block is at the top of the current segment and meets the trim
+ *  threshold, then lower the top.
+ *
+ * @param   block   Pointer to block to release.
+ * @return  Whether or not the release completed successfully.
+ **/
+bool    segment_release(Block *block) {
+    Segment *segment = segment_find(block);
+    if (!segment || block->data + block->capacity != segment->top) {
+        return false;
+    }
+
+    if (segment->start != SegmentCurrent) {
+        if ((char *)block != segment->start + SEGMENT_GUARD) {
+            return false;
+        }
+
+        segment_unmap(segment);
+        return true;
+    }
+
+    size_t allocated = sizeof(Block) + block->capacity;
+    if (allocated <= TRIM_THRESHOLD) {
+        return false;
+    }
+
+    segment->top = (char *)block;
+    pagemap_clear(block, allocated);
+    Counters[BLOCKS]--;
+    Counters[SHRINKS]++;
+    Counters[HEAP_SIZE] -= allocated;
+    return true;
+}
+
+/**
+ * Attempt to resize an allocated block that is the only block of a segment
+ * (other than the current one) by remapping the segment, so that the kernel
+ * moves its pages instead of us copying them.
+ *
+ * Note, the block gets the whole pages of the new mapping, and the segment is
+ * moved in the table if the mapping moved.
+ *
+ * @param   block       Pointer to block to resize.
+ * @param   allocated   Number of bytes the block needs (including the header).
+ * @return  Pointer to resized block (otherwise NULL).
+ **/
+Block * segment_resize(Block *block, size_t allocated) {
+    Segment *segment = segment_find(block);
+    if (!segment || segment->start == SegmentCurrent || (char *)block != segment->start + SEGMENT_GUARD ||
+        block->data + block->capacity != segment->top) {
+        return NULL;
+    }
+
+    size_t length = PAGE_ALIGN(SEGMENT_GUARD + allocated);
+    if (length < allocated) {
+        return NULL;
+    }
+
+    char *start = length == segment->length ? segment->start : mremap(segment->start, segment->length, length, MREMAP_MAYMOVE);
+    if (start == MAP_FAILED) {
+        return NULL;
+    }
+
+    pagemap_clear(segment->start, segment->length);
+    Counters[SEGMENT_BYTES] += length - segment->length;
+    Counters[HEAP_SIZE]     += length - (segment->top - segment->start);
+
+    if (start != segment->start) {
+        SegmentsCount--;
+        memmove(segment, segment + 1, (SegmentsCount - (segment - Segments)) * sizeof(Segment));
+
+        segment = &Segments[segment_index(start)];
+        memmove(segment + 1, segment, (SegmentsCount - (segment - Segments)) * sizeof(Segment));
+        SegmentsCount++;
+    }
+
+    segment->start  = start;
+    segment->top    = start + length;
+    segment->length = length;
+    segment->free   = 0;
+
+    block = (Block *)(start + SEGMENT_GUARD);
+    block->capacity = length - SEGMENT_GUARD - sizeof(Block);
+    pagemap_mark(block, length - SEGMENT_GUARD, PAGEMAP_HEAP);
+    return block;
+}
+
+/**
+ * Return whether or not the specified block ends at the top of the current
+ * segment.
+ * @param   block   Pointer to block.
+ **/
+bool    segment_at_top(Block *block) {
+    Segment *segment = segment_find(SegmentCurrent);
+
+    return segment && block->data + block->capacity == segment->top;
+}
+
+/**
+ * Add the bytes of a block that entered the free list to its segment, and
+ * unmap the segment if all of its blocks are free (unless it is the current
+ * one).
+ *
+ * Note, this requires the MainArena lock.
+ *
+ * @param   segment Pointer to segment (or NULL).
+ * @param   bytes   Capacity of the block plus its header.
+ **/
+void    segment_free(Segment *segment, size_t bytes) {
+    if (!segment) {
+        return;
+    }
+
+    segment->free += bytes;
+    if (segment->start != SegmentCurrent && segment->free == (size_t)(segment->top - segment->start - SEGMENT_GUARD)) {
+        segment_unmap(segment);
+    }
+}
+
+/**
+ * Subtract the bytes of a block that left the free list from its segment.
+ *
+ * Note, this requires the MainArena lock.
+ *
+ * @param   block   Pointer to block taken out of the free list.
+ **/
+void    segment_take(Block *block) {
+    Segment *segment = segment_find(block);
+    if (segment) {
+        segment->free -= sizeof(Block) + block->capacity;
+    }
+}
+
+/**
+ * Return the number of mapped segments.
+ **/
+size_t  segment_count() {
+    return SegmentsCount;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
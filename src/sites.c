@@ -0,0 +1,171 @@
+/* sites.c: Per Call Site Statistics
+ *
+ * When the MALLOC_SITES environment variable is set to K, every allocation is
+ * attributed to its call site (the return address of malloc) in a fixed-size
+ * open addressing table, and the top K call sites are displayed by
+ * dump_counters.
+ *
+ * To track live bytes without a separate pointer table, the call site is
+ * stored in the prev link of the allocated block, which is otherwise unused
+ * while the block is not in the free list.  It is restored when the block is
+ * freed.
+ **/
+
+#define _GNU_SOURCE     /* For dladdr */
+
+#include "malloc/counters.h"
+#include "malloc/sites.h"
+
+#include <dlfcn.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Global Variables */
+
+bool        SitesEnabled = false;
+static int  SitesTop     = 0;
+static Site Sites[SITES_SLOTS + 1];     /* Last entry collects overflow */
+
+/* Functions */
+
+/**
+ * Enable call site tracking if the SITES_ENV environment variable is set to
+ * a positive number of call sites to display.
+ *
+ * Note, this should only be called once (from init_counters).
+ **/
+void    sites_init() {
+    char *top = getenv(SITES_ENV);
+    if (!top || atoi(top) <= 0) {
+        return;
+    }
+
+    SitesTop     = atoi(top) < SITES_TOP ? atoi(top) : SITES_TOP;
+    SitesEnabled = true;
+}
+
+/**
+ * Find (or insert) the entry for the specified call site.
+ * @param   address     Return address of the caller.
+ * @return  Pointer to the entry (the overflow entry if the table is full).
+ **/
+static Site *sites_lookup(void *address) {
+    size_t slot = (((uintptr_t)address) * 0x9E3779B97F4A7C15UL >> 32) & (SITES_SLOTS - 1);
+
+    for (size_t probes = 0; probes < SITES_SLOTS; probes++) {
+        Site *site = &Sites[slot];
+        if (site->address == address) {
+            return site;
+        }
+
+        if (!site->address) {
+            site->address = address;
+            return site;
+        }
+
+        slot = (slot + 1) & (SITES_SLOTS - 1);
+    }
+
+    return &Sites[SITES_SLOTS];
+}
+
+/**
+ * Attribute an allocation to its call site and tag the block with it.
+ * @param   block       Pointer to allocated block.
+ * @param   address     Return address of the caller.
+ * @param   grows       Number of heap grows caused by the allocation.
+ * @param   splits      Number of block splits caused by the allocation.
+ **/
+void    sites_malloc(Block *block, void *address, size_t grows, size_t splits) {
+    Site *site = sites_lookup(address);
+
+    site->mallocs++;
+    site->bytes  += block->size;
+    site->grows  += grows;
+    site->splits += splits;
+
+    sites_tag(block, site);
+}
+
+/**
+ * Tag an allocated block with its call site and add it to the live bytes of
+ * the call site.
+ * @param   block       Pointer to allocated block.
+ * @param   site        Pointer to call site entry.
+ **/
+void    sites_tag(Block *block, Site *site) {
+    site->live += block->size;
+    block->prev = (Block *)site;
+}
+
+/**
+ * Remove a freed block from the live bytes of its call site (if it has one)
+ * and restore the prev link of the block.
+ * @param   block       Pointer to block being freed.
+ * @return  Pointer to call site entry (otherwise NULL if block was untagged).
+ **/
+Site *  sites_free(Block *block) {
+    Site *site = (Site *)block->prev;
+
+    block->prev = block;
+    if (site >= Sites && site <= &Sites[SITES_SLOTS]) {
+        site->live -= block->size;
+        return site;
+    }
+
+    return NULL;
+}
+
+/**
+ * Display the call sites with the most allocations to the specified file
+ * descriptor.
+ * @param   fd          File descriptor to write to.
+ **/
+void    sites_dump(int fd) {
+    char  buffer[BUFSIZ];
+    Site *top[SITES_TOP];
+    int   ntop = 0;
+
+    // Keep the top call sites sorted by number of allocations
+    for (size_t slot = 0; slot <= SITES_SLOTS; slot++) {
+        Site *site = &Sites[slot];
+        if (!site->mallocs) {
+            continue;
+        }
+
+        if (ntop < SitesTop) {
+            top[ntop++] = site;
+        } else if (site->mallocs > top[ntop - 1]->mallocs) {
+            top[ntop - 1] = site;
+        } else {
+            continue;
+        }
+
+        for (int i = ntop - 1; i > 0 && top[i - 1]->mallocs < top[i]->mallocs; i--) {
+            Site *swap = top[i - 1];
+            top[i - 1] = top[i];
+            top[i]     = swap;
+        }
+    }
+
+    fdprintf(fd, buffer, "sites:\n");
+    for (int i = 0; i < ntop; i++) {
+        Site   *site = top[i];
+        Dl_info info = {0};
+        char    name[128] = "?";
+
+        if (!site->address) {
+            strcpy(name, "(other)");
+        } else if (dladdr(site->address, &info) && info.dli_sname) {
+            snprintf(name, sizeof(name), "%s+0x%lx", info.dli_sname, (uintptr_t)site->address - (uintptr_t)info.dli_saddr);
+        } else if (info.dli_fname) {
+            snprintf(name, sizeof(name), "%s+0x%lx", strrchr(info.dli_fname, '/') ? strrchr(info.dli_fname, '/') + 1 : info.dli_fname, (uintptr_t)site->address - (uintptr_t)info.dli_fbase);
+        }
+
+        fdprintf(fd, buffer, "  %-32s mallocs: %-8lu bytes: %-10lu live: %-10lu grows: %-6lu splits: %lu\n",
+            name, site->mallocs, site->bytes, site->live, site->grows, site->splits);
+    }
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
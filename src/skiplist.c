@@ -0,0 +1,185 @@
+/* skiplist.c: Skip List Index
+ *
+ * The skip list indexes the blocks in the free list by address, so that the
+ * address-ordered policy can find the neighbors of a block in O(log n)
+ * instead of scanning the whole free list.
+ *
+ * Since the block header has no room for the forward links, the nodes live
+ * outside of the heap in chunks mapped with mmap, and removed nodes are kept
+ * in a stack (linked through next[0]) for reuse.
+ **/
+
+#include "malloc/skiplist.h"
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+/* Global Variables */
+
+static SkipNode     SkipHead  = {NULL, {NULL}};
+static int          SkipLevel = 1;                      /* Levels in use */
+static size_t       SkipCount = 0;                      /* Indexed blocks */
+static SkipNode *   SkipFree  = NULL;                   /* Unused nodes */
+static uint64_t     SkipSeed  = 0x2545F4914F6CDD1DUL;
+
+/* Functions */
+
+/**
+ * Take an unused node (mapping a new chunk of nodes if necessary).
+ * @return  Pointer to node (otherwise NULL if no memory is available).
+ **/
+static SkipNode *skiplist_node() {
+    if (!SkipFree) {
+        SkipNode *chunk = mmap(NULL, SKIPLIST_CHUNK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (chunk == MAP_FAILED) {
+            return NULL;
+        }
+
+        for (size_t i = 0; i < SKIPLIST_CHUNK / sizeof(SkipNode); i++) {
+            chunk[i].next[0] = SkipFree;
+            SkipFree = &chunk[i];
+        }
+    }
+
+    SkipNode *node = SkipFree;
+    SkipFree = node->next[0];
+    return node;
+}
+
+/**
+ * Pick the number of levels of a new node (each level is a quarter as likely
+ * as the one below it).
+ **/
+static int skiplist_level() {
+    SkipSeed ^= SkipSeed << 13;
+    SkipSeed ^= SkipSeed >> 7;
+    SkipSeed ^= SkipSeed << 17;
+
+    int level = 1;
+    for (uint64_t bits = SkipSeed; level < SKIPLIST_LEVELS && (bits & 3) == 0; bits >>= 2) {
+        level++;
+    }
+    return level;
+}
+
+/**
+ * Find the last node at each level whose block is lower than the specified
+ * block.
+ * @param   block   Block to search for.
+ * @param   update  Array to store the last node of each level in.
+ * @return  Pointer to the first node whose block is not lower (otherwise
+ * NULL).
+ **/
+static SkipNode *skiplist_find(Block *block, SkipNode **update) {
+    SkipNode *curr = &SkipHead;
+
+    for (int level = SkipLevel - 1; level >= 0; level--) {
+        while (curr->next[level] && curr->next[level]->block < block) {
+            curr = curr->next[level];
+        }
+        update[level] = curr;
+    }
+
+    return curr->next[0];
+}
+
+/**
+ * Add the specified block to the index.
+ * @param   block   Pointer to block to index.
+ * @return  Whether or not the block was indexed.
+ **/
+bool    skiplist_insert(Block *block) {
+    SkipNode *update[SKIPLIST_LEVELS];
+    SkipNode *next = skiplist_find(block, update);
+    if (next && next->block == block) {
+        return true;
+    }
+
+    SkipNode *node = skiplist_node();
+    if (!node) {
+        return false;
+    }
+
+    int level = skiplist_level();
+    for (; SkipLevel < level; SkipLevel++) {
+        update[SkipLevel] = &SkipHead;
+    }
+
+    node->block = block;
+    for (int i = 0; i < level; i++) {
+        node->next[i]      = update[i]->next[i];
+        update[i]->next[i] = node;
+    }
+
+    for (int i = level; i < SKIPLIST_LEVELS; i++) {
+        node->next[i] = NULL;
+    }
+
+    SkipCount++;
+    return true;
+}
+
+/**
+ * Remove the specified block from the index.
+ * @param   block   Pointer to indexed block.
+ * @return  Whether or not the block was indexed.
+ **/
+bool    skiplist_remove(Block *block) {
+    SkipNode *update[SKIPLIST_LEVELS];
+    SkipNode *node = skiplist_find(block, update);
+    if (!node || node->block != block) {
+        return false;
+    }
+
+    for (int i = 0; i < SkipLevel && update[i]->next[i] == node; i++) {
+        update[i]->next[i] = node->next[i];
+    }
+
+    while (SkipLevel > 1 && !SkipHead.next[SkipLevel - 1]) {
+        SkipLevel--;
+    }
+
+    node->next[0] = SkipFree;
+    SkipFree      = node;
+    SkipCount--;
+    return true;
+}
+
+/**
+ * Replace an indexed block with another block that takes its place in the
+ * address order (i.e. there is no indexed block between the two).
+ * @param   old_block   Pointer to indexed block.
+ * @param   new_block   Pointer to replacement block.
+ * @return  Whether or not the old block was indexed.
+ **/
+bool    skiplist_replace(Block *old_block, Block *new_block) {
+    SkipNode *update[SKIPLIST_LEVELS];
+    SkipNode *node = skiplist_find(old_block, update);
+    if (!node || node->block != old_block) {
+        return false;
+    }
+
+    node->block = new_block;
+    return true;
+}
+
+/**
+ * Find the indexed block with the highest address lower than the specified
+ * block.
+ * @param   block   Pointer to block.
+ * @return  Pointer to lower block (otherwise NULL if there is none).
+ **/
+Block * skiplist_lower(Block *block) {
+    SkipNode *update[SKIPLIST_LEVELS];
+    skiplist_find(block, update);
+    return update[0]->block;
+}
+
+/**
+ * Return number of indexed blocks.
+ **/
+size_t  skiplist_length() {
+    return SkipCount;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,247 @@
+/* stats.c: Shared Memory Statistics
+ *
+ * When the MALLOC_STATS environment variable is set, the allocator publishes
+ * its counters into a small POSIX shared memory segment named after the
+ * process ID (see STATS_NAME).  External tools such as mstat can map the
+ * segment read-only and sample it without disturbing the process.
+ *
+ * The page is updated with seqlock semantics: the writer makes the sequence
+ * odd, copies the counters, and then makes the sequence even again.  Readers
+ * retry whenever they observe an odd sequence or the sequence changed while
+ * they were copying.
+ *
+ * Every switch of the adaptive policy is also logged to a ring of the last
+ * STATS_SWITCHES switches (indexed by the number of switches so far).
+ *
+ * The counters of each arena (its remote frees and drains) are also broken
+ * down into the arenas of the page.  The MainArena is the only arena so far,
+ * so its counts are the totals kept in the Counters.  Likewise, the hits,
+ * frees and cached blocks of the per-CPU caches (if any) are broken down into
+ * the cpus of the page (up to STATS_CPUS of them).
+ **/
+
+#include "malloc/block.h"
+#include "malloc/buddy.h"
+#include "malloc/counters.h"
+#include "malloc/fastbins.h"
+#include "malloc/maxheap.h"
+#include "malloc/percpu.h"
+#include "malloc/stats.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Global Variables */
+
+extern Block FreeList;
+Stats *StatsPage = NULL;
+
+/* Functions */
+
+/**
+ * Forget the stats page in a forked child so that it does not publish into
+ * (or unlink) the segment that belongs to its parent.
+ **/
+static void stats_detach() {
+    if (StatsPage) {
+        munmap(StatsPage, sizeof(Stats));
+        StatsPage = NULL;
+    }
+}
+
+/**
+ * Count the free blocks kept apart from the free list by the fast bins and
+ * the per-CPU caches.
+ * @param   bytes   Where to store the capacity of those blocks.
+ * @param   largest Largest free capacity so far (raised to the largest
+ * binned block).
+ * @return  Number of those blocks.
+ **/
+static size_t stats_cached(size_t *bytes, size_t *largest) {
+    Block *binned = fastbins_largest();
+    if (binned && binned->capacity > *largest) {
+        *largest = binned->capacity;
+    }
+
+    *bytes = fastbins_bytes() + percpu_bytes();
+    return fastbins_length() + percpu_length();
+}
+
+/**
+ * Copy the remote free counters of the MainArena to the specified entry.
+ * @param   arena   Pointer to arena entry of the stats page.
+ **/
+static void stats_arena(StatsArena *arena) {
+    arena->remote_frees = __atomic_load_n(&Counters[REMOTE_FREES], __ATOMIC_RELAXED);
+    arena->drains       = Counters[DRAINS];
+    arena->drained      = Counters[DRAINED];
+    arena->drain_max    = Counters[DRAIN_MAX];
+    arena->queued       = arena->remote_frees - arena->drained;
+}
+
+/**
+ * Create and map the shared memory stats page if the STATS_ENV environment
+ * variable is set (and not "0").
+ *
+ * Note, this should only be called once (from init_counters).
+ **/
+void    stats_init() {
+    char *enabled = getenv(STATS_ENV);
+    if (!enabled || !*enabled || !strcmp(enabled, "0")) {
+        return;
+    }
+
+    char name[BUFSIZ];
+    sprintf(name, STATS_NAME, getpid());
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return;
+    }
+
+    if (ftruncate(fd, sizeof(Stats)) < 0) {
+        close(fd);
+        shm_unlink(name);
+        return;
+    }
+
+    Stats *page = mmap(NULL, sizeof(Stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        shm_unlink(name);
+        return;
+    }
+
+    page->version   = STATS_VERSION;
+    page->ncounters = NCOUNTERS;
+    page->narenas   = STATS_ARENAS;
+    page->pid       = getpid();
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    page->started   = now.tv_sec * 1000000000UL + now.tv_nsec;
+    __atomic_store_n(&page->magic, STATS_MAGIC, __ATOMIC_RELEASE);
+
+    StatsPage = page;
+    atexit(stats_fini);
+    pthread_atfork(NULL, NULL, stats_detach);
+    stats_publish();
+}
+
+/**
+ * Publish the current counters to the shared memory stats page (if it
+ * exists).
+ *
+ * Every STATS_INTERVAL updates the free list is also scanned to refresh the
+ * free block summary used to compute fragmentation (unless the free list is
+ * kept in a max-heap, in which case the summary is refreshed every update).
+ * The free buddy blocks and the blocks in the fast bins and per-CPU caches (if
+ * any) are part of the summary as well.
+ **/
+void    stats_publish() {
+    Stats *page = StatsPage;
+    if (!page) {
+        return;
+    }
+
+    uint32_t sequence = page->sequence;
+    __atomic_store_n(&page->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (MaxHeapEnabled) {
+        Block *largest      = maxheap_peek();
+        size_t cached       = 0;
+        size_t largest_free = largest ? largest->capacity : 0;
+
+        page->updates++;
+        page->free_blocks  = maxheap_length() + stats_cached(&cached, &largest_free);
+        page->free_bytes   = maxheap_bytes() + cached;
+        page->largest_free = largest_free;
+    } else if (page->updates++ % STATS_INTERVAL == 0) {
+        Block *largest      = buddy_largest();
+        size_t cached       = 0;
+        size_t largest_free = largest ? largest->capacity : 0;
+        size_t free_blocks  = buddy_length() + stats_cached(&cached, &largest_free);
+        size_t free_bytes   = buddy_bytes() + cached;
+
+        for (Block *curr = FreeList.next; curr != &FreeList; curr = curr->next) {
+            free_blocks++;
+            free_bytes += curr->capacity;
+            if (curr->capacity > largest_free) {
+                largest_free = curr->capacity;
+            }
+        }
+
+        page->free_blocks  = free_blocks;
+        page->free_bytes   = free_bytes;
+        page->largest_free = largest_free;
+    }
+
+    // Include the cache hits and frees of the per-CPU caches
+    if (PerCpuEnabled) {
+        percpu_collect();
+    }
+    memcpy(page->counters, Counters, sizeof(Counters));
+    stats_arena(&page->arenas[0]);
+    if (PerCpuEnabled) {
+        page->ncpus = percpu_publish(page->cpus, STATS_CPUS);
+    }
+
+    __atomic_store_n(&page->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * Log a switch of the adaptive policy to the shared memory stats page (if it
+ * exists).
+ * @param   from        Policy before the switch.
+ * @param   to          Policy after the switch.
+ * @param   free_ratio  Free bytes per 100 bytes of heap that were sampled.
+ * @param   steps       Blocks visited per search that were sampled.
+ **/
+void    stats_switch(int from, int to, size_t free_ratio, size_t steps) {
+    Stats *page = StatsPage;
+    if (!page) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    uint32_t sequence = page->sequence;
+    __atomic_store_n(&page->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    StatsSwitch *entry = &page->log[page->switches % STATS_SWITCHES];
+    entry->time       = now.tv_sec * 1000000000UL + now.tv_nsec;
+    entry->from       = from;
+    entry->to         = to;
+    entry->free_ratio = free_ratio;
+    entry->steps      = steps;
+    page->switches++;
+
+    __atomic_store_n(&page->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * Unmap and remove the shared memory stats page (if it exists).
+ **/
+void    stats_fini() {
+    Stats *page = StatsPage;
+    if (!page) {
+        return;
+    }
+
+    char name[BUFSIZ];
+    sprintf(name, STATS_NAME, page->pid);
+
+    StatsPage = NULL;
+    munmap(page, sizeof(Stats));
+    shm_unlink(name);
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
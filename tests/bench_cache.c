@@ -0,0 +1,124 @@
+/* bench_cache.c: measure the cache misses of reusing freed blocks
+ *
+ * Frees every other block of a heap much larger than the L2 cache (so that
+ * the freed blocks cannot merge), then keeps allocating, writing and freeing
+ * a block.  A FIFO free list hands out the coldest block every time, while
+ * MALLOC_HOT_REUSE hands back the block that was just freed.
+ *
+ * The misses of the loop are read with perf_event_open (the last level cache
+ * references are the misses of the L2 cache on most processors), and are
+ * reported as n/a where the kernel does not allow it.
+ *
+ * Usage: env LD_PRELOAD=./lib/libmalloc-ff.so [MALLOC_HOT_REUSE=1] ./bin/bench_cache
+ **/
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Constants */
+
+#define BLOCKS      (1<<8)              /* Blocks allocated (half are freed) */
+#define SIZE        (1<<15)             /* Size of each block */
+#define ITERATIONS  (1<<15)             /* Allocations measured */
+
+/* Events */
+
+enum {
+    L1D_MISSES,
+    LLC_REFERENCES,
+    LLC_MISSES,
+    NEVENTS,
+};
+
+static const char *EventNames[NEVENTS] = {
+    "l1d misses",
+    "l2 misses",
+    "llc misses",
+};
+
+/* Functions */
+
+/**
+ * Open a counter for the specified event of this thread (in user space).
+ * @return  File descriptor of counter (otherwise -1).
+ **/
+static int event_open(uint32_t type, uint64_t config, int group) {
+    struct perf_event_attr attributes;
+
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size           = sizeof(attributes);
+    attributes.type           = type;
+    attributes.config         = config;
+    attributes.disabled       = group < 0;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv     = 1;
+
+    return syscall(SYS_perf_event_open, &attributes, 0, -1, group, 0);
+}
+
+/* Main Execution */
+
+int main(int argc, char *argv[]) {
+    char **p = malloc(sizeof(char *) * BLOCKS);
+
+    for (int i = 0; i < BLOCKS; i++) {
+        p[i] = malloc(SIZE);
+        memset(p[i], 0, SIZE);
+    }
+
+    for (int i = 0; i < BLOCKS; i += 2) {
+        free(p[i]);
+    }
+
+    int events[NEVENTS];
+    events[L1D_MISSES]     = event_open(PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), -1);
+    events[LLC_REFERENCES] = event_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, events[L1D_MISSES]);
+    events[LLC_MISSES]     = event_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, events[L1D_MISSES]);
+
+    if (events[L1D_MISSES] >= 0) {
+        ioctl(events[L1D_MISSES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(events[L1D_MISSES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    volatile long sum = 0;
+    for (int i = 0; i < ITERATIONS; i++) {
+        char *q = malloc(SIZE);
+        for (int j = 0; j < SIZE; j += 64) {
+            sum += q[j]++;
+        }
+        free(q);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (events[L1D_MISSES] >= 0) {
+        ioctl(events[L1D_MISSES], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    fprintf(stderr, "%.3lf s", (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+    for (int e = 0; e < NEVENTS; e++) {
+        long long count = 0;
+        if (events[e] >= 0 && read(events[e], &count, sizeof(count)) == sizeof(count)) {
+            fprintf(stderr, ", %s: %lld", EventNames[e], count);
+        } else {
+            fprintf(stderr, ", %s: n/a", EventNames[e]);
+        }
+    }
+    fprintf(stderr, "\n");
+
+    return EXIT_SUCCESS;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -30,6 +30,10 @@ int main(int argc, char *argv[]) {
     	assert(pc == p2);
     } else if (strstr(argv[1], "wf")) {
     	assert(pc == p1);
+    } else if (strstr(argv[1], "ao")) {
+    	assert(pc == p0);
+    } else if (strstr(argv[1], "gf")) {
+    	assert(pc == p2);
     }
 
     free(pa);
@@ -0,0 +1,196 @@
+/* unit_adaptive.c: Unit tests for adaptive fit policy */
+
+#include "malloc/adaptive.h"
+#include "malloc/block.h"
+#include "malloc/counters.h"
+#include "malloc/freelist.h"
+#include "malloc/stats.h"
+
+#include <assert.h>
+#include <string.h>
+
+/* Externals */
+
+extern Block   FreeList;
+extern Stats * StatsPage;
+extern Block * free_list_search_ff(size_t size);
+
+/* Constants */
+
+#define MAX_BLOCKS  256
+
+/* Functions */
+
+/**
+ * Pretend another ADAPTIVE_INTERVAL searches went by with the specified
+ * blocks visited per search and free bytes per 100 bytes of heap.
+ **/
+void    adaptive_run(size_t steps, size_t free_ratio) {
+    Counters[SEARCHES]     += ADAPTIVE_INTERVAL;
+    Counters[SEARCH_STEPS] += ADAPTIVE_INTERVAL * steps;
+    Counters[HEAP_SIZE]     = 1000;
+    Counters[FREE_BYTES]    = free_ratio * 10;
+    adaptive_sample();
+}
+
+int test_00_adaptive_tighter() {
+    setenv(ADAPTIVE_ENV, "1", 1);
+    setenv(STATS_ENV, "1", 1);
+    adaptive_init();
+    stats_init();
+    assert(AdaptiveEnabled);
+    assert(AdaptivePolicy == ADAPTIVE_FF);
+
+    // Samples are only taken every ADAPTIVE_INTERVAL searches
+    Counters[HEAP_SIZE]  = 1000;
+    Counters[FREE_BYTES] = 900;
+    Counters[SEARCHES]   = ADAPTIVE_INTERVAL - 1;
+    for (int i = 0; i < 2 * ADAPTIVE_VOTES; i++) {
+        adaptive_sample();
+    }
+    assert(AdaptivePolicy == ADAPTIVE_FF);
+    Counters[SEARCHES] = 0;
+
+    // A sample in the band between the thresholds starts the votes over
+    for (int i = 0; i < ADAPTIVE_VOTES - 1; i++) {
+        adaptive_run(1, ADAPTIVE_FREE_HIGH);
+    }
+    adaptive_run(1, ADAPTIVE_FREE_HIGH - 1);
+    for (int i = 0; i < ADAPTIVE_VOTES - 1; i++) {
+        adaptive_run(1, ADAPTIVE_FREE_HIGH);
+    }
+    assert(AdaptivePolicy == ADAPTIVE_FF);
+
+    adaptive_run(1, ADAPTIVE_FREE_HIGH);
+    assert(AdaptivePolicy == ADAPTIVE_GF);
+    assert(Counters[POLICY_SWITCHES] == 1);
+
+    // The switch is logged to the stats page
+    assert(StatsPage->switches == 1);
+    assert(StatsPage->log[0].from == ADAPTIVE_FF);
+    assert(StatsPage->log[0].to   == ADAPTIVE_GF);
+    assert(StatsPage->log[0].free_ratio == ADAPTIVE_FREE_HIGH);
+    assert(StatsPage->log[0].steps == 1);
+    assert(StatsPage->sequence % 2 == 0);
+
+    // Best fit is as tight as it gets
+    for (int i = 0; i < 4 * ADAPTIVE_VOTES; i++) {
+        adaptive_run(1, 50);
+    }
+    assert(AdaptivePolicy == ADAPTIVE_BF);
+    assert(Counters[POLICY_SWITCHES] == 2);
+    assert(StatsPage->switches == 2);
+    stats_fini();
+    return EXIT_SUCCESS;
+}
+
+int test_01_adaptive_cheaper() {
+    setenv(ADAPTIVE_ENV, "1", 1);
+    adaptive_init();
+    AdaptivePolicy = ADAPTIVE_BF;
+
+    // Short searches are fine even with little free memory
+    for (int i = 0; i < 2 * ADAPTIVE_VOTES; i++) {
+        adaptive_run(ADAPTIVE_STEPS_HIGH - 1, 0);
+    }
+    assert(AdaptivePolicy == ADAPTIVE_BF);
+
+    // Long searches are not worth it once little memory is free
+    for (int i = 0; i < ADAPTIVE_VOTES; i++) {
+        adaptive_run(ADAPTIVE_STEPS_HIGH, ADAPTIVE_FREE_LOW);
+    }
+    assert(AdaptivePolicy == ADAPTIVE_GF);
+
+    for (int i = 0; i < 4 * ADAPTIVE_VOTES; i++) {
+        adaptive_run(ADAPTIVE_STEPS_HIGH, 0);
+    }
+    assert(AdaptivePolicy == ADAPTIVE_FF);
+    assert(Counters[POLICY_SWITCHES] == 2);
+    return EXIT_SUCCESS;
+}
+
+int test_02_adaptive_search() {
+    setenv(ADAPTIVE_ENV, "1", 1);
+    adaptive_init();
+
+    // Keep the blocks apart so that they do not merge
+    Block *blocks[6];
+    size_t sizes[6] = {1000, 64, 200, 64, 120, 64};
+    for (int i = 0; i < 6; i++) {
+        blocks[i] = block_allocate(sizes[i]);
+        assert(blocks[i]);
+    }
+    for (int i = 0; i < 6; i += 2) {
+        free_list_insert(blocks[i]);
+    }
+    assert(Counters[FREE_BYTES] == 3 * sizeof(Block) + 1320);
+
+    assert(free_list_search(100) == blocks[0]);
+    assert(Counters[SEARCHES] == 1);
+    assert(Counters[SEARCH_STEPS] == 1);
+
+    AdaptivePolicy = ADAPTIVE_GF;
+    assert(free_list_search(100) == blocks[4]);
+    assert(Counters[SEARCH_STEPS] == 4);
+
+    AdaptivePolicy = ADAPTIVE_BF;
+    assert(free_list_search(100) == blocks[4]);
+    assert(Counters[SEARCH_STEPS] == 7);
+    assert(Counters[SEARCHES] == 3);
+    return EXIT_SUCCESS;
+}
+
+int test_03_adaptive_free_bytes() {
+    static Block *blocks[MAX_BLOCKS];
+
+    // Churn the free list and check the bytes it holds against a scan
+    srand(0);
+    for (int round = 0; round < 8 * MAX_BLOCKS; round++) {
+        int i = rand() % MAX_BLOCKS;
+        if (blocks[i]) {
+            free_list_insert(blocks[i]);
+            blocks[i] = NULL;
+        } else {
+            size_t size  = 1 + rand() % 512;
+            Block *block = free_list_search_ff(size);
+            blocks[i] = block ? free_list_take(block, size) : block_allocate(size);
+            assert(blocks[i]);
+        }
+
+        size_t bytes = 0;
+        for (Block *curr = FreeList.next; curr != &FreeList; curr = curr->next) {
+            bytes += sizeof(Block) + curr->capacity;
+        }
+        assert(Counters[FREE_BYTES] == bytes);
+    }
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test adaptive_tighter\n");
+        fprintf(stderr, "    1. Test adaptive_cheaper\n");
+        fprintf(stderr, "    2. Test adaptive_search\n");
+        fprintf(stderr, "    3. Test adaptive_free_bytes\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_adaptive_tighter(); break;
+        case 1:  status = test_01_adaptive_cheaper(); break;
+        case 2:  status = test_02_adaptive_search(); break;
+        case 3:  status = test_03_adaptive_free_bytes(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,104 @@
+/* unit_arena.c: Unit tests for arena lock and remote free queue */
+
+#include "malloc/arena.h"
+#include "malloc/counters.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+
+/* Constants */
+
+#define THREADS     4
+#define PUSHES      1000
+
+/* Functions */
+
+void *trylock_thread(void *arg) {
+    return (void *)(intptr_t)arena_trylock(&MainArena);
+}
+
+void *push_thread(void *arg) {
+    Block *blocks = arg;
+    for (size_t i = 0; i < PUSHES; i++) {
+        arena_push(&MainArena, &blocks[i]);
+    }
+    return NULL;
+}
+
+int test_00_arena_lock() {
+    void *locked;
+
+    assert(arena_trylock(&MainArena));
+    assert(arena_trylock(&MainArena));
+
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, trylock_thread, NULL) == 0);
+    assert(pthread_join(thread, &locked) == 0);
+    assert(locked == (void *)false);
+
+    arena_unlock(&MainArena);
+    arena_unlock(&MainArena);
+
+    assert(pthread_create(&thread, NULL, trylock_thread, NULL) == 0);
+    assert(pthread_join(thread, &locked) == 0);
+    assert(locked == (void *)true);
+    return EXIT_SUCCESS;
+}
+
+int test_01_arena_push() {
+    static Block blocks[THREADS][PUSHES];
+    pthread_t    threads[THREADS];
+
+    assert(arena_drain(&MainArena) == NULL);
+    assert(Counters[DRAINS] == 0);
+
+    for (size_t t = 0; t < THREADS; t++) {
+        assert(pthread_create(&threads[t], NULL, push_thread, blocks[t]) == 0);
+    }
+
+    for (size_t t = 0; t < THREADS; t++) {
+        assert(pthread_join(threads[t], NULL) == 0);
+    }
+
+    arena_lock(&MainArena);
+    size_t count = 0;
+    for (Block *curr = arena_drain(&MainArena); curr; curr = curr->next) {
+        assert(curr >= &blocks[0][0] && curr <= &blocks[THREADS - 1][PUSHES - 1]);
+        count++;
+    }
+    assert(arena_drain(&MainArena) == NULL);
+    arena_unlock(&MainArena);
+
+    assert(count == THREADS * PUSHES);
+    assert(Counters[REMOTE_FREES] == THREADS * PUSHES);
+    assert(Counters[DRAINS]       == 1);
+    assert(Counters[DRAINED]      == THREADS * PUSHES);
+    assert(Counters[DRAIN_MAX]    == THREADS * PUSHES);
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test arena_lock\n");
+        fprintf(stderr, "    1. Test arena_push\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_arena_lock(); break;
+        case 1:  status = test_01_arena_push(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
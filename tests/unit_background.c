@@ -0,0 +1,92 @@
+/* unit_background.c: Unit tests for background thread */
+
+#include "malloc/background.h"
+#include "malloc/block.h"
+#include "malloc/counters.h"
+#include "malloc/freelist.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/* Constants */
+
+#define BLOCKS      20
+
+/* Functions */
+
+int test_00_background_trim() {
+    Block *b0 = block_allocate(16);
+    Block *b1 = block_allocate(TRIM_THRESHOLD);
+    Block *b2 = block_allocate(16);
+    assert(b0 && b1 && b2);
+
+    // Merged into a block at the top of the heap that was never released
+    free_list_insert(b2);
+    free_list_insert(b1);
+    assert(free_list_length() == 1);
+    assert(block_at_top(b1));
+
+    background_run();
+    assert(free_list_length() == 0);
+    assert(sbrk(0) == (void *)b1);
+    assert(Counters[SHRINKS] == 1);
+    assert(Counters[BACKGROUND_RUNS] == 1);
+    return EXIT_SUCCESS;
+}
+
+int test_01_background_purge() {
+    Block *blocks[BLOCKS];
+
+    for (size_t i = 0; i < BLOCKS; i++) {
+        blocks[i] = block_allocate(4 * BASE_PAGE_SIZE);
+        assert(blocks[i]);
+    }
+
+    for (size_t i = 0; i < BLOCKS - 1; i += 2) {
+        free_list_insert(blocks[i]);
+    }
+
+    // Each idle run purges another BACKGROUND_DECAY fraction of free memory
+    size_t purged = 0;
+    for (size_t run = 1; run <= BACKGROUND_DECAY; run++) {
+        background_run();
+        assert(Counters[PURGED] > purged);
+        purged = Counters[PURGED];
+    }
+
+    assert(purged >= BLOCKS / 2 * 3 * BASE_PAGE_SIZE);
+    background_run();
+    assert(Counters[PURGED] == purged);
+
+    // Activity stops the purging
+    Counters[MALLOCS]++;
+    background_run();
+    assert(Counters[PURGED] == purged);
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test background_trim\n");
+        fprintf(stderr, "    1. Test background_purge\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_background_trim(); break;
+        case 1:  status = test_01_background_purge(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -5,6 +5,7 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <string.h>
 
 /* Functions */
 
@@ -108,6 +109,175 @@ int test_04_block_split() {
     return EXIT_SUCCESS;
 }
 
+int test_05_block_align() {
+    size_t s0 = 100;
+    size_t a0 = 256;
+    Block *b0 = block_allocate(s0 + a0 + sizeof(Block) + ALIGNMENT);
+    assert(b0);
+
+    size_t c0 = b0->capacity;
+    b0->size  = s0;
+
+    Block *b1 = block_align(b0, a0);
+    assert(b1);
+    assert((intptr_t)b1->data % a0 == 0);
+    assert(b1->size == s0);
+    assert(b1->prev == b1);
+    assert(b1->next == b1);
+    assert(b0->capacity >= ALIGNMENT);
+    assert((Block *)(b0->data + b0->capacity) == b1);
+    assert(b0->capacity + sizeof(Block) + b1->capacity == c0);
+    assert(Counters[SPLITS] == 1);
+    assert(Counters[BLOCKS] == 2);
+
+    assert(block_align(b1, a0) == b1);
+    assert(block_align(b1, a0 << 1) == NULL || (intptr_t)b1->data % (a0 << 1) == 0);
+    assert(Counters[BLOCKS] == 2);
+    return EXIT_SUCCESS;
+}
+
+int test_06_block_allocate_huge() {
+    HugePages = true;
+
+    size_t s0 = 100;
+    Block *b0 = block_allocate(s0);
+    assert(b0);
+    assert((intptr_t)b0 % HUGE_PAGE_SIZE == 0);
+    assert(HeapStart == (char *)b0);
+    assert(HeapEnd   == HeapStart + HUGE_PAGE_SIZE);
+    assert(Counters[HUGE_HEAP] == HUGE_PAGE_SIZE);
+    assert(Counters[HEAP_SIZE] == sizeof(Block) + ALIGN(s0));
+
+    size_t s1 = HUGE_PAGE_SIZE;
+    Block *b1 = block_allocate(s1);
+    assert(b1);
+    assert((char *)b1 == b0->data + b0->capacity);
+    assert(HeapEnd   == HeapStart + 2 * HUGE_PAGE_SIZE);
+    assert(Counters[HUGE_HEAP] == 2 * HUGE_PAGE_SIZE);
+    assert(Counters[GROWS] == 2);
+
+    assert(block_release(b0) == false);
+    assert(block_release(b1) == true);
+    assert(HeapEnd   == HeapStart + 2 * HUGE_PAGE_SIZE);
+    assert(Counters[SHRINKS] == 1);
+    assert(Counters[HEAP_SIZE] == sizeof(Block) + ALIGN(s0));
+
+    Block *b2 = block_allocate(s1);
+    assert(b2 == b1);
+    return EXIT_SUCCESS;
+}
+
+int test_07_block_carve() {
+    size_t s0 = 20;
+    size_t n0 = 5;
+    size_t stride = sizeof(Block) + ALIGN(s0);
+    Block *b0 = block_allocate(n0 * stride - sizeof(Block) + ALIGNMENT);
+    assert(b0);
+    assert(Counters[BLOCKS] == 1);
+
+    Block *blocks[8];
+    assert(block_carve(b0, s0, blocks, 8) == n0);
+    assert(blocks[0] == b0);
+    assert(Counters[BLOCKS] == n0);
+    for (size_t i = 0; i < n0; i++) {
+        assert(blocks[i]->size == s0);
+        assert(blocks[i]->prev == blocks[i]);
+        assert(blocks[i]->next == blocks[i]);
+        assert(blocks[i]->capacity == ALIGN(s0) + (i == n0 - 1 ? ALIGNMENT : 0));
+        assert(i == 0 || (Block *)(blocks[i - 1]->data + blocks[i - 1]->capacity) == blocks[i]);
+    }
+
+    Block *b1 = block_allocate(n0 * stride);
+    assert(b1);
+    assert(block_carve(b1, s0, blocks, 2) == 2);
+    assert(b1->capacity == ALIGN(s0));
+    assert(blocks[1]->capacity == (n0 - 1) * stride);
+    assert((char *)blocks[1] == b1->data + b1->capacity);
+    assert(Counters[BLOCKS] == n0 + 2);
+    return EXIT_SUCCESS;
+}
+
+int test_08_block_coalesce() {
+    size_t s0 = 24;
+    Block *b0 = block_allocate(4 * (sizeof(Block) + s0) - sizeof(Block));
+    Block *blocks[4];
+    assert(b0);
+    assert(block_carve(b0, s0, blocks, 4) == 4);
+
+    Block *batch[3] = {blocks[3], blocks[0], blocks[1]};
+    assert(block_coalesce(batch, 3) == 2);
+    assert(batch[0] == blocks[0]);
+    assert(batch[0]->capacity == 2 * s0 + sizeof(Block));
+    assert(batch[1] == blocks[3]);
+    assert(batch[1]->capacity == s0);
+    assert(Counters[MERGES] == 1);
+    assert(Counters[BLOCKS] == 3);
+
+    Block *last[2] = {blocks[2], batch[1]};
+    assert(block_coalesce(last, 2) == 1);
+    assert(last[0] == blocks[2]);
+    assert(last[0]->capacity == 2 * s0 + sizeof(Block));
+    return EXIT_SUCCESS;
+}
+
+int test_09_block_purge() {
+    Block *b0 = block_allocate(16);
+    Block *b1 = block_allocate(4 * BASE_PAGE_SIZE);
+    Block *b2 = block_allocate(16);
+    assert(b0 && b1 && b2);
+
+    memset(b1->data, 1, b1->capacity);
+
+    size_t purged = block_purge(b1);
+    assert(purged >= 3 * BASE_PAGE_SIZE);
+    assert(purged <= 4 * BASE_PAGE_SIZE);
+    assert(*(size_t *)b1->data == 0x0101010101010101UL);
+
+    size_t zeros = 0;
+    for (size_t i = 0; i < b1->capacity; i++) {
+        zeros += b1->data[i] == 0;
+    }
+    assert(zeros == purged);
+    assert(block_purge(b0) == 0);
+    return EXIT_SUCCESS;
+}
+
+int test_10_block_allocate_reserved() {
+    setenv(RESERVE_ENV, "1", 1);
+    block_init();
+    assert(Reserved);
+    assert(HeapStart == HeapEnd);
+
+    size_t s0 = 100;
+    Block *b0 = block_allocate(s0);
+    assert(b0);
+    assert(HeapStart == (char *)b0);
+    assert(HeapEnd   == HeapStart + BASE_PAGE_SIZE);
+    assert(Counters[COMMITTED] == BASE_PAGE_SIZE);
+
+    size_t s1 = 8 * BASE_PAGE_SIZE;
+    Block *b1 = block_allocate(s1);
+    assert(b1);
+    assert((char *)b1 == b0->data + b0->capacity);
+    assert(HeapEnd   == HeapStart + PAGE_ALIGN(2 * sizeof(Block) + ALIGN(s0) + s1));
+    assert(Counters[COMMITTED] == (size_t)(HeapEnd - HeapStart));
+    memset(b1->data, 1, b1->capacity);
+
+    // The pages past the one spare page are decommitted
+    assert(block_release(b0) == false);
+    assert(block_release(b1) == true);
+    assert(HeapEnd   == HeapStart + 2 * BASE_PAGE_SIZE);
+    assert(Counters[COMMITTED] == 2 * BASE_PAGE_SIZE);
+    assert(Counters[DECOMMITTED] == PAGE_ALIGN(2 * sizeof(Block) + ALIGN(s0) + s1) - 2 * BASE_PAGE_SIZE);
+    assert(Counters[HEAP_SIZE] == sizeof(Block) + ALIGN(s0));
+
+    // Decommitted pages read as zero once they are committed again
+    Block *b2 = block_allocate(s1);
+    assert(b2 == b1);
+    assert(b2->data[s1 - 1] == 0);
+    return EXIT_SUCCESS;
+}
+
 /* Main execution */
 
 int main(int argc, char *argv[]) {
@@ -119,6 +289,12 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "    2. Test block_detach\n");
         fprintf(stderr, "    3. Test block_merge\n");
         fprintf(stderr, "    4. Test block_split\n");
+        fprintf(stderr, "    5. Test block_align\n");
+        fprintf(stderr, "    6. Test block_allocate (huge pages)\n");
+        fprintf(stderr, "    7. Test block_carve\n");
+        fprintf(stderr, "    8. Test block_coalesce\n");
+        fprintf(stderr, "    9. Test block_purge\n");
+        fprintf(stderr, "    10. Test block_allocate (reserved)\n");
         return EXIT_FAILURE;
     }
 
@@ -131,6 +307,12 @@ int main(int argc, char *argv[]) {
         case 2:  status = test_02_block_detach(); break;
         case 3:  status = test_03_block_merge(); break;
         case 4:  status = test_04_block_split(); break;
+        case 5:  status = test_05_block_align(); break;
+        case 6:  status = test_06_block_allocate_huge(); break;
+        case 7:  status = test_07_block_carve(); break;
+        case 8:  status = test_08_block_coalesce(); break;
+        case 9:  status = test_09_block_purge(); break;
+        case 10: status = test_10_block_allocate_reserved(); break;
         default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
     }
 
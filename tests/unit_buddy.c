@@ -0,0 +1,177 @@
+/* unit_buddy.c: Unit tests for buddy allocator */
+
+#include "malloc/block.h"
+#include "malloc/buddy.h"
+#include "malloc/counters.h"
+#include "malloc/freelist.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+/* Externals */
+
+extern Block FreeList;
+
+/* Functions */
+
+int test_00_buddy_take() {
+    buddy_init();
+    assert(BuddyEnabled);
+
+    // The first search commits a whole chunk
+    Block *b0 = buddy_search(90);
+    assert(b0);
+    assert(b0->capacity == BUDDY_MAX_CAPACITY);
+    assert(buddy_owns(b0));
+    assert(Counters[GROWS] == 1);
+    assert(Counters[HEAP_SIZE] == BUDDY_CHUNK);
+
+    // Taking it splits off one free half of every order down to 128 bytes
+    assert(buddy_take(b0, 90) == b0);
+    assert(b0->capacity == 128 - sizeof(Block));
+    assert(b0->size == 90);
+    assert(b0->next == b0 && b0->prev == b0);
+    assert(Counters[SPLITS] == BUDDY_MAX_ORDER - 7);
+    assert(buddy_length() == BUDDY_MAX_ORDER - 7);
+    assert(buddy_bytes() == BUDDY_CHUNK - 128 - (BUDDY_MAX_ORDER - 7) * sizeof(Block));
+
+    // The next request of the same order takes the free half right after it
+    Block *b1 = buddy_search(96);
+    assert(b1 == (Block *)((char *)b0 + 128));
+    assert(buddy_take(b1, 96) == b1);
+    assert(Counters[REUSES] == 1);
+
+    // Blocks are at least 2^BUDDY_MIN_ORDER bytes
+    Block *b2 = buddy_take(buddy_search(1), 1);
+    assert(b2->capacity == (1 << BUDDY_MIN_ORDER) - sizeof(Block));
+    assert(buddy_largest()->capacity == BUDDY_CHUNK / 2 - sizeof(Block));
+    return EXIT_SUCCESS;
+}
+
+int test_01_buddy_insert() {
+    buddy_init();
+
+    Block *b0 = buddy_take(buddy_search(32), 32);
+    Block *b1 = buddy_take(buddy_search(32), 32);
+    Block *b2 = buddy_take(buddy_search(200), 200);
+    assert(b1 == (Block *)((char *)b0 + 64));
+    assert(b2 == (Block *)((char *)b0 + 256));
+
+    // A block whose buddy is in use is not merged
+    size_t length = buddy_length();
+    buddy_insert(b0);
+    assert(buddy_length() == length + 1);
+    assert(Counters[MERGES] == 0);
+
+    // Freeing the buddy merges the pair (and then the free 128 bytes after)
+    buddy_insert(b1);
+    assert(Counters[MERGES] == 2);
+    assert(buddy_length() == length);
+
+    // Freeing the last block merges everything back into the chunk
+    buddy_insert(b2);
+    assert(buddy_length() == 1);
+    assert(buddy_largest() == b0);
+    assert(b0->capacity == BUDDY_MAX_CAPACITY);
+    assert(Counters[BLOCKS] == 1);
+    return EXIT_SUCCESS;
+}
+
+int test_02_buddy_free_list() {
+    buddy_init();
+
+    Block *b0 = free_list_search(990);
+    assert(b0 && buddy_owns(b0));
+    b0 = free_list_take(b0, 990);
+    assert(b0->capacity == 1024 - sizeof(Block));
+
+    // Larger requests are left to the free list
+    assert(free_list_search(BUDDY_MAX_CAPACITY + 1) == NULL);
+    Block *b1 = block_allocate(BUDDY_MAX_CAPACITY + 1);
+    assert(b1 && !buddy_owns(b1));
+
+    free_list_insert(b1);
+    assert(FreeList.next == b1);
+    free_list_insert(b0);
+    assert(FreeList.prev == b1);
+    assert(free_list_length() == 2);
+    return EXIT_SUCCESS;
+}
+
+int test_03_buddy_waste() {
+    buddy_init();
+
+    // Only the rounding of the blocks in use is counted
+    Block *b0 = buddy_take(buddy_search(90), 90);
+    Block *b1 = buddy_take(buddy_search(1), 1);
+    assert(Counters[BUDDY_WASTE] == (128 - sizeof(Block) - 90) + (64 - sizeof(Block) - 1));
+
+    buddy_insert(b0);
+    assert(Counters[BUDDY_WASTE] == 64 - sizeof(Block) - 1);
+    buddy_insert(b1);
+    assert(Counters[BUDDY_WASTE] == 0);
+    return EXIT_SUCCESS;
+}
+
+int test_04_buddy_align() {
+    buddy_init();
+
+    // The data right after the header is aligned to the size of the header
+    assert(buddy_padding(sizeof(Block), 90) == 0);
+    Block *b0 = buddy_take(buddy_search(90), 90);
+    assert(buddy_align(b0, sizeof(Block), 90) == b0);
+
+    // Larger alignments move the header into a block twice as large
+    size_t padding = buddy_padding(256, 100);
+    Block *b1      = buddy_take(buddy_search(100 + padding), 100 + padding);
+    assert(b1->capacity == 512 - sizeof(Block));
+
+    Block *b2 = buddy_align(b1, 256, 100);
+    assert((uintptr_t)b2->data % 256 == 0);
+    assert(b2->data == (char *)b1 + 256);
+    assert(b2->data + b2->capacity == (char *)b1 + 512);
+    assert(b2->size == 100 && b2->next == b2 && b2->prev == b2);
+    assert(Counters[BUDDY_WASTE] == (128 - sizeof(Block) - 90) + (512 - sizeof(Block) - 100));
+
+    // Freeing the moved header frees the whole block
+    size_t length = buddy_length();
+    buddy_insert(b2);
+    assert(buddy_length() == length + 1);
+    assert(Counters[BUDDY_WASTE] == 128 - sizeof(Block) - 90);
+
+    buddy_insert(b0);
+    assert(buddy_length() == 1);
+    assert(buddy_largest()->capacity == BUDDY_MAX_CAPACITY);
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test buddy_take\n");
+        fprintf(stderr, "    1. Test buddy_insert\n");
+        fprintf(stderr, "    2. Test buddy_free_list\n");
+        fprintf(stderr, "    3. Test buddy_waste\n");
+        fprintf(stderr, "    4. Test buddy_align\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_buddy_take(); break;
+        case 1:  status = test_01_buddy_insert(); break;
+        case 2:  status = test_02_buddy_free_list(); break;
+        case 3:  status = test_03_buddy_waste(); break;
+        case 4:  status = test_04_buddy_align(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
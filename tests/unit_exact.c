@@ -0,0 +1,175 @@
+/* unit_exact.c: Unit tests for exact fit index */
+
+#include "malloc/block.h"
+#include "malloc/counters.h"
+#include "malloc/exact.h"
+#include "malloc/freelist.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+/* Functions */
+
+int test_00_exact_search() {
+    setenv(EXACT_ENV, "1", 1);
+    exact_init();
+    assert(ExactEnabled);
+
+    Block *b0 = block_allocate(64);
+    Block *b1 = block_allocate(64);
+    Block *b2 = block_allocate(128);
+    Block *b3 = block_allocate(16);
+    assert(b0 && b1 && b2 && b3);
+
+    exact_insert(b0);
+    exact_insert(b1);
+    exact_insert(b2);
+    exact_insert(b3);
+
+    // Blocks with the same capacity come back last in, first out
+    assert(exact_search(57) == b1);
+    assert(b1->size == 57);
+    assert(exact_search(128) == b2);
+    assert(exact_search(72) == NULL);
+    assert(exact_search(120) == NULL);
+
+    // Blocks too small for the links are not indexed
+    assert(exact_search(16) == NULL);
+    return EXIT_SUCCESS;
+}
+
+int test_01_exact_remove() {
+    setenv(EXACT_ENV, "1", 1);
+    exact_init();
+
+    Block *b0 = block_allocate(64);
+    Block *b1 = block_allocate(64);
+    Block *b2 = block_allocate(64);
+    Block *b3 = block_allocate(8);
+    assert(b0 && b1 && b2 && b3);
+
+    exact_insert(b0);
+    exact_insert(b1);
+    exact_insert(b2);
+    exact_insert(b3);
+
+    exact_remove(b1, b1->capacity);
+    assert(exact_search(64) == b2);
+    exact_remove(b2, b2->capacity);
+    assert(exact_search(64) == b0);
+
+    // Removal goes by the capacity the block was inserted with
+    b0->capacity = 256;
+    exact_remove(b0, 64);
+    exact_insert(b0);
+    assert(exact_search(64) == NULL);
+    assert(exact_search(256) == b0);
+
+    exact_remove(b3, b3->capacity);
+    exact_remove(b0, b0->capacity);
+    assert(exact_search(256) == NULL);
+    return EXIT_SUCCESS;
+}
+
+int test_02_exact_free_list() {
+    setenv(EXACT_ENV, "1", 1);
+    exact_init();
+
+    Block *b0 = block_allocate(64);
+    Block *k0 = block_allocate(16);
+    Block *b1 = block_allocate(256);
+    Block *b2 = block_allocate(64);
+    Block *k1 = block_allocate(16);
+    assert(b0 && k0 && b1 && b2 && k1);
+
+    free_list_insert(b0);
+    free_list_insert(b1);
+    assert(free_list_search(64) == b0);
+    assert(Counters[EXACT_HITS] == 1);
+    assert(free_list_search(24) == NULL);
+    assert(Counters[EXACT_MISSES] == 1);
+
+    // A split leaves the rest of the block in the index
+    assert(free_list_take(b1, 200) == b1);
+    Block *rest = (Block *)(b1->data + 200);
+    assert(free_list_search(rest->capacity) == rest);
+    assert(free_list_search(256) == NULL);
+
+    // A merge moves the block to the bucket of its new capacity
+    size_t capacity = rest->capacity;
+    free_list_insert(b2);
+    assert(free_list_length() == 2);
+    assert(free_list_search(capacity) == NULL);
+    assert(free_list_search(capacity + 64 + sizeof(Block)) == rest);
+    assert(free_list_search(64) == b0);
+
+    assert(free_list_take(b0, 64) == b0);
+    assert(free_list_search(64) == NULL);
+    return EXIT_SUCCESS;
+}
+
+int test_03_exact_capacities() {
+    setenv(EXACT_ENV, "1", 1);
+    exact_init();
+
+    // More distinct capacities than buckets
+    static Block *blocks[2 * EXACT_BUCKETS];
+    size_t count = 2 * EXACT_BUCKETS;
+
+    size_t indexed = 0;
+    for (size_t i = 0; i < count; i++) {
+        blocks[i] = block_allocate(EXACT_MIN + i * ALIGNMENT);
+        assert(blocks[i]);
+        exact_insert(blocks[i]);
+    }
+
+    // Each block comes back only for its own capacity
+    for (size_t i = 0; i < count; i++) {
+        Block *block = exact_search(blocks[i]->capacity);
+        assert(!block || block == blocks[i]);
+        indexed += block != NULL;
+    }
+    assert(indexed >= EXACT_BUCKETS / 2);
+
+    // Blocks that were left out are removed harmlessly
+    for (size_t i = 0; i < count; i++) {
+        exact_remove(blocks[i], blocks[i]->capacity);
+        assert(exact_search(blocks[i]->capacity) == NULL);
+    }
+
+    // Empty stacks are taken by new capacities
+    Block *b0 = block_allocate(EXACT_MIN + count * ALIGNMENT);
+    assert(b0);
+    exact_insert(b0);
+    assert(exact_search(b0->capacity) == b0);
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test exact_search\n");
+        fprintf(stderr, "    1. Test exact_remove\n");
+        fprintf(stderr, "    2. Test exact_free_list\n");
+        fprintf(stderr, "    3. Test exact_capacities\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_exact_search(); break;
+        case 1:  status = test_01_exact_remove(); break;
+        case 2:  status = test_02_exact_free_list(); break;
+        case 3:  status = test_03_exact_capacities(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
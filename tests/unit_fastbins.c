@@ -0,0 +1,132 @@
+/* unit_fastbins.c: Unit tests for fast bins */
+
+#include "malloc/block.h"
+#include "malloc/counters.h"
+#include "malloc/fastbins.h"
+#include "malloc/freelist.h"
+
+#include <assert.h>
+#include <string.h>
+
+/* Externals */
+
+extern Block FreeList;
+
+/* Functions */
+
+int test_00_fastbins_push() {
+    setenv(FASTBINS_ENV, "128", 1);
+    fastbins_init();
+    assert(FastBinsEnabled);
+
+    Block *b0 = block_allocate(64);
+    Block *b1 = block_allocate(64);
+    Block *b2 = block_allocate(200);
+    assert(b0 && b1 && b2);
+
+    assert(fastbins_push(b0));
+    assert(fastbins_push(b1));
+    assert(!fastbins_push(b2));
+    assert(free_list_length() == 0);
+    assert(Counters[FAST_FREES] == 2);
+    assert(fastbins_length() == 2);
+    assert(fastbins_bytes() == 2 * 64);
+    assert(fastbins_largest() == b1);
+
+    assert(fastbins_pop(48) == NULL);
+    assert(fastbins_pop(57) == b1);
+    assert(b1->size == 57);
+    assert(b1->next == b1);
+    assert(fastbins_pop(64) == b0);
+    assert(fastbins_pop(64) == NULL);
+    assert(fastbins_pop(200) == NULL);
+    assert(fastbins_length() == 0);
+    assert(fastbins_bytes() == 0);
+    assert(fastbins_largest() == NULL);
+    assert(Counters[FAST_REUSES] == 2);
+    assert(Counters[MERGES] == 0);
+    assert(Counters[SPLITS] == 0);
+    return EXIT_SUCCESS;
+}
+
+int test_01_fastbins_consolidate() {
+    setenv(FASTBINS_ENV, "1024", 1);
+    fastbins_init();
+
+    Block *b0 = block_allocate(64);
+    Block *b1 = block_allocate(64);
+    Block *b2 = block_allocate(32);
+    Block *b3 = block_allocate(FASTBINS_MAX);
+    assert(b0 && b1 && b2 && b3);
+
+    assert(fastbins_consolidate() == 0);
+
+    assert(fastbins_push(b0));
+    assert(fastbins_push(b2));
+    assert(fastbins_push(b1));
+    assert(fastbins_consolidate() == 3);
+    assert(Counters[CONSOLIDATES] == 1);
+    assert(fastbins_length() == 0);
+    assert(fastbins_bytes() == 0);
+
+    // Adjacent binned blocks are merged once they reach the free list
+    assert(free_list_length() == 1);
+    assert(FreeList.next == b0);
+    assert(b0->capacity == 64 + 64 + 32 + 2 * sizeof(Block));
+    assert(fastbins_pop(64) == NULL);
+
+    // Blocks at the top of the heap are released
+    size_t shrinks = Counters[SHRINKS];
+    assert(fastbins_push(b3));
+    assert(fastbins_consolidate() == 1);
+    assert(Counters[SHRINKS] == shrinks + 1);
+    assert(free_list_length() == 1);
+    return EXIT_SUCCESS;
+}
+
+int test_02_fastbins_threshold() {
+    setenv(FASTBINS_ENV, "1024", 1);
+    fastbins_init();
+
+    Block *keep = block_allocate(16);
+    assert(keep);
+
+    size_t pushed = 0;
+    while (!Counters[CONSOLIDATES]) {
+        Block *block = block_allocate(FASTBINS_MAX);
+        assert(block);
+        assert(fastbins_push(block));
+        pushed++;
+    }
+
+    assert(pushed == FASTBINS_THRESHOLD / FASTBINS_MAX + 1);
+    assert(fastbins_pop(FASTBINS_MAX) == NULL);
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test fastbins_push\n");
+        fprintf(stderr, "    1. Test fastbins_consolidate\n");
+        fprintf(stderr, "    2. Test fastbins_threshold\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_fastbins_push(); break;
+        case 1:  status = test_01_fastbins_consolidate(); break;
+        case 2:  status = test_02_fastbins_threshold(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -13,6 +13,7 @@ extern Block FreeList;
 extern Block *free_list_search_ff(size_t size);
 extern Block *free_list_search_bf(size_t size);
 extern Block *free_list_search_wf(size_t size);
+extern Block *free_list_search_gf(size_t size);
 
 /* Functions */
 
@@ -95,6 +96,109 @@ int test_04_free_list_length() {
     return EXIT_SUCCESS;
 }
 
+int test_05_free_list_insert_ao() {
+    Block *b0 = block_allocate(100);
+    Block *b1 = block_allocate(100);
+    Block *b2 = block_allocate(100);
+    Block *b3 = block_allocate(100);
+    Block *b4 = block_allocate(100);
+    assert(b0 && b1 && b2 && b3 && b4);
+
+    free_list_insert_ao(b3);
+    free_list_insert_ao(b0);
+    assert(FreeList.next == b0);
+    assert(b0->next == b3);
+    assert(b3->next == &FreeList);
+    assert(FreeList.prev == b3);
+
+    // Merge the next block into the inserted block
+    free_list_insert_ao(b2);
+    assert(b0->next == b2);
+    assert(b2->next == &FreeList);
+    assert(FreeList.prev == b2);
+    assert(b2->capacity == 2 * ALIGN(100) + sizeof(Block));
+    assert(Counters[MERGES] == 1);
+
+    // Merge the inserted block into the previous block and then the next one
+    free_list_insert_ao(b1);
+    assert(FreeList.next == b0);
+    assert(FreeList.prev == b0);
+    assert(b0->next == &FreeList);
+    assert(b0->prev == &FreeList);
+    assert(b0->capacity == 4 * ALIGN(100) + 3 * sizeof(Block));
+    assert(Counters[MERGES] == 3);
+    assert(Counters[BLOCKS] == 2);
+    assert(free_list_length() == 1);
+    return EXIT_SUCCESS;
+}
+
+int test_06_free_list_search_gf() {
+    Block b3 = {.capacity = ALIGN(200), .size = 200, .prev = NULL     , .next = &FreeList };
+    Block b2 = {.capacity = ALIGN(208), .size = 208, .prev = NULL     , .next = &b3 };
+    Block b1 = {.capacity = ALIGN(240), .size = 240, .prev = NULL     , .next = &b2 };
+    Block b0 = {.capacity = ALIGN(400), .size = 400, .prev = &FreeList, .next = &b1 };
+    b1.prev = &b0; b2.prev = &b1; b3.prev = &b2;
+    FreeList.next = &b0; FreeList.prev = &b3;
+
+    assert(free_list_search_gf(1000) == NULL);
+
+    // Stop at the first block within the slack
+    GoodFitSlack      = 12;
+    GoodFitCandidates = 16;
+    assert(free_list_search_gf(200) == &b2);
+    assert(b2.size == 200);
+    assert(free_list_search_gf(400) == &b0);
+
+    // Without slack it is best fit
+    GoodFitSlack = 0;
+    assert(free_list_search_gf(200) == &b3);
+
+    // Take the best of the candidates tried
+    GoodFitCandidates = 2;
+    assert(free_list_search_gf(200) == &b1);
+    GoodFitCandidates = 1;
+    assert(free_list_search_gf(200) == &b0);
+    return EXIT_SUCCESS;
+}
+
+int test_07_free_list_insert_hot() {
+    Block *b0 = block_allocate(100);
+    Block *s0 = block_allocate(16);
+    Block *b1 = block_allocate(100);
+    Block *s1 = block_allocate(16);
+    Block *b2 = block_allocate(100);
+    Block *b3 = block_allocate(100);
+    Block *s2 = block_allocate(16);
+    Block *b4 = block_allocate(100);
+    Block *s3 = block_allocate(16);
+    assert(b0 && s0 && b1 && s1 && b2 && b3 && s2 && b4 && s3);
+
+    // Without hot reuse, first fit gets the block freed first
+    free_list_insert(b0);
+    free_list_insert(b1);
+    free_list_insert(b3);
+    assert(FreeList.next == b0);
+    assert(FreeList.prev == b3);
+    assert(free_list_search_ff(100) == b0);
+
+    // With hot reuse, it gets the block freed last
+    HotReuse = true;
+    free_list_insert(b4);
+    assert(FreeList.next == b4);
+    assert(free_list_search_ff(100) == b4);
+
+    // A block that absorbs the next block moves to the front with it
+    free_list_insert(b2);
+    assert(FreeList.next == b2);
+    assert(b2->capacity == 2 * ALIGN(100) + sizeof(Block));
+
+    // A block absorbed by the previous block stays where that block is
+    free_list_insert(s0);
+    assert(FreeList.next == b2);
+    assert(free_list_length() == 4);
+    return EXIT_SUCCESS;
+}
+
 /* Main execution */
 
 int main(int argc, char *argv[]) {
@@ -106,6 +210,9 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "    2. Test free_list_search_wf\n");
         fprintf(stderr, "    3. Test free_list_insert\n");
         fprintf(stderr, "    4. Test free_list_length\n");
+        fprintf(stderr, "    5. Test free_list_insert_ao\n");
+        fprintf(stderr, "    6. Test free_list_search_gf\n");
+        fprintf(stderr, "    7. Test free_list_insert (hot reuse)\n");
         return EXIT_FAILURE;
     }
 
@@ -118,6 +225,9 @@ int main(int argc, char *argv[]) {
         case 2:  status = test_02_free_list_search_wf(); break;
         case 3:  status = test_03_free_list_insert(); break;
         case 4:  status = test_04_free_list_length(); break;
+        case 5:  status = test_05_free_list_insert_ao(); break;
+        case 6:  status = test_06_free_list_search_gf(); break;
+        case 7:  status = test_07_free_list_insert_hot(); break;
         default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
     }
 
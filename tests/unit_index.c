@@ -0,0 +1,133 @@
+/* unit_index.c: Unit tests for capacity index */
+
+#include "malloc/block.h"
+#include "malloc/index.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Constants */
+
+#define BLOCKS      (INDEX_SLOTS + 1000)
+#define SEARCHES    1000
+
+/* Functions */
+
+int test_00_index_search() {
+    index_init();
+    assert(IndexEnabled);
+
+    Block *b0 = block_allocate(64);
+    Block *b1 = block_allocate(32);
+    Block *b2 = block_allocate(128);
+    Block *b3 = block_allocate(32);
+    assert(b0 && b1 && b2 && b3);
+
+    index_insert(b0);
+    index_insert(b1);
+    index_insert(b2);
+    index_insert(b3);
+
+    assert(index_search_bf(20) == b1);
+    assert(b1->size == 20);
+    assert(index_search_bf(33) == b0);
+    assert(index_search_bf(100) == b2);
+    assert(index_search_bf(129) == NULL);
+
+    assert(index_search_wf(20) == b2);
+    assert(b2->size == 20);
+    assert(index_search_wf(129) == NULL);
+    return EXIT_SUCCESS;
+}
+
+int test_01_index_remove() {
+    index_init();
+
+    Block *b0 = block_allocate(64);
+    Block *b1 = block_allocate(32);
+    Block *b2 = block_allocate(128);
+    assert(b0 && b1 && b2);
+
+    index_insert(b0);
+    index_insert(b1);
+    index_insert(b2);
+
+    index_remove(b0);
+    assert(INDEX_SLOT(b2) == 0);
+    assert(index_search_bf(33) == b2);
+
+    index_remove(b2);
+    assert(index_search_bf(33) == NULL);
+    assert(index_search_wf(1) == b1);
+
+    b1->capacity = 256;
+    index_update(b1);
+    assert(index_search_bf(200) == b1);
+
+    index_replace(b1, b0);
+    assert(INDEX_SLOT(b0) == 0);
+    assert(index_search_wf(1) == b0);
+    assert(index_search_bf(100) == NULL);
+    return EXIT_SUCCESS;
+}
+
+int test_02_index_kernels() {
+    static Block *blocks[BLOCKS];
+    static Block *found[3][2][SEARCHES];
+    const char   *kernels[] = {"scalar", "sse4", "avx2"};
+
+    for (size_t i = 0; i < BLOCKS; i++) {
+        blocks[i] = block_allocate(8 + rand() % 512);
+        assert(blocks[i]);
+    }
+
+    for (size_t k = 0; k < 3; k++) {
+        setenv(INDEX_ISA_ENV, kernels[k], 1);
+        index_init();
+
+        // Grow past the initial slots and leave a tail that does not fill a vector
+        for (size_t i = 0; i < BLOCKS - 1; i++) {
+            index_insert(blocks[i]);
+        }
+
+        srand(0);
+        for (size_t s = 0; s < SEARCHES; s++) {
+            size_t size = 1 + rand() % 600;
+            found[k][0][s] = index_search_bf(size);
+            found[k][1][s] = index_search_wf(size);
+        }
+    }
+
+    unsetenv(INDEX_ISA_ENV);
+    assert(memcmp(found[0], found[1], sizeof(found[0])) == 0);
+    assert(memcmp(found[0], found[2], sizeof(found[0])) == 0);
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test index_search\n");
+        fprintf(stderr, "    1. Test index_remove\n");
+        fprintf(stderr, "    2. Test index_kernels\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_index_search(); break;
+        case 1:  status = test_01_index_remove(); break;
+        case 2:  status = test_02_index_kernels(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,140 @@
+/* unit_maxheap.c: Unit tests for max-heap index */
+
+#include "malloc/block.h"
+#include "malloc/maxheap.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+/* Constants */
+
+#define BLOCKS      (MAXHEAP_SLOTS + 1000)
+
+/* Functions */
+
+int test_00_maxheap_insert() {
+    maxheap_init();
+    assert(MaxHeapEnabled);
+    assert(maxheap_peek() == NULL);
+
+    Block *b0 = block_allocate(64);
+    Block *b1 = block_allocate(128);
+    Block *b2 = block_allocate(32);
+    Block *b3 = block_allocate(128);
+    assert(b0 && b1 && b2 && b3);
+
+    maxheap_insert(b0);
+    assert(maxheap_peek() == b0);
+    maxheap_insert(b1);
+    maxheap_insert(b2);
+    maxheap_insert(b3);
+
+    // Ties go to the block inserted first
+    assert(maxheap_peek() == b1);
+    assert(maxheap_length() == 4);
+    assert(maxheap_bytes() == 64 + 128 + 32 + 128);
+
+    assert(maxheap_search(129) == NULL);
+    assert(maxheap_search(20) == b1);
+    assert(b1->size == 20);
+    return EXIT_SUCCESS;
+}
+
+int test_01_maxheap_remove() {
+    maxheap_init();
+
+    Block *b0 = block_allocate(64);
+    Block *b1 = block_allocate(128);
+    Block *b2 = block_allocate(32);
+    Block *b3 = block_allocate(128);
+    assert(b0 && b1 && b2 && b3);
+
+    maxheap_insert(b0);
+    maxheap_insert(b1);
+    maxheap_insert(b2);
+    maxheap_insert(b3);
+
+    maxheap_remove(b1);
+    assert(maxheap_peek() == b3);
+    maxheap_remove(b3);
+    assert(maxheap_peek() == b0);
+
+    // A replacement keeps the order of the block it replaces
+    maxheap_replace(b0, b1);
+    assert(maxheap_peek() == b1);
+    maxheap_insert(b3);
+    assert(maxheap_peek() == b1);
+
+    b1->capacity = 16;
+    maxheap_update(b1);
+    assert(maxheap_peek() == b3);
+    assert(maxheap_length() == 3);
+    assert(maxheap_bytes() == 16 + 32 + 128);
+    return EXIT_SUCCESS;
+}
+
+int test_02_maxheap_random() {
+    static Block *blocks[BLOCKS];
+    static bool   inserted[BLOCKS];
+
+    maxheap_init();
+    for (size_t i = 0; i < BLOCKS; i++) {
+        blocks[i] = block_allocate(8 + rand() % 512);
+        assert(blocks[i]);
+        maxheap_insert(blocks[i]);
+        inserted[i] = true;
+    }
+
+    for (size_t round = 0; round < BLOCKS; round++) {
+        size_t i = rand() % BLOCKS;
+        if (inserted[i]) {
+            maxheap_remove(blocks[i]);
+        } else {
+            maxheap_insert(blocks[i]);
+        }
+        inserted[i] = !inserted[i];
+
+        // Root is the largest block that was inserted first
+        Block *largest = NULL;
+        size_t bytes   = 0;
+        for (size_t j = 0; j < BLOCKS; j++) {
+            if (inserted[j]) {
+                bytes += blocks[j]->capacity;
+                if (!largest || blocks[j]->capacity > largest->capacity) {
+                    largest = blocks[j];
+                }
+            }
+        }
+
+        assert(maxheap_bytes() == bytes);
+        assert(maxheap_peek()->capacity == largest->capacity);
+    }
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test maxheap_insert\n");
+        fprintf(stderr, "    1. Test maxheap_remove\n");
+        fprintf(stderr, "    2. Test maxheap_random\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_maxheap_insert(); break;
+        case 1:  status = test_01_maxheap_remove(); break;
+        case 2:  status = test_02_maxheap_random(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,141 @@
+/* unit_pagemap.c: Unit tests for page map */
+
+#include "malloc/block.h"
+#include "malloc/counters.h"
+#include "malloc/pagemap.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+/* Constants */
+
+#define PAGE        (1UL<<PAGEMAP_PAGE_SHIFT)
+#define ROOT        (PAGEMAP_FANOUT * sizeof(void *))
+#define NODES       (PAGEMAP_FANOUT * sizeof(void *) + PAGEMAP_FANOUT * sizeof(uint32_t))
+
+/* Functions */
+
+int test_00_pagemap_mark() {
+    setenv(PAGEMAP_ENV, "1", 1);
+    pagemap_init();
+    assert(PageMapEnabled);
+
+    char *base = (char *)(1UL << 40);
+    assert(pagemap_lookup(base) == PAGEMAP_NONE);
+    assert(Counters[PAGEMAP_BYTES] == ROOT);
+
+    // Only the range is marked on the pages it overlaps
+    assert(pagemap_mark(base + PAGE - 8, 16, PAGEMAP_HEAP));
+    assert(pagemap_lookup(base) == PAGEMAP_NONE);
+    assert(pagemap_lookup(base + PAGE - 9) == PAGEMAP_NONE);
+    assert(pagemap_lookup(base + PAGE - 8) == PAGEMAP_HEAP);
+    assert(pagemap_lookup(base + PAGE + 7) == PAGEMAP_HEAP);
+    assert(pagemap_lookup(base + PAGE + 8) == PAGEMAP_NONE);
+    assert(Counters[PAGEMAP_BYTES] == ROOT + NODES);
+
+    // Pages in the same leaf do not map more nodes
+    assert(pagemap_mark(base + 8 * PAGE, PAGE, PAGEMAP_BUDDY));
+    assert(pagemap_lookup(base + 8 * PAGE) == PAGEMAP_BUDDY);
+    assert(pagemap_lookup(base + 9 * PAGE - 1) == PAGEMAP_BUDDY);
+    assert(Counters[PAGEMAP_BYTES] == ROOT + NODES);
+
+    // Addresses beyond the tree are never ours
+    assert(pagemap_lookup((void *)UINTPTR_MAX) == PAGEMAP_NONE);
+    assert(!pagemap_mark((void *)(1UL << 60), PAGE, PAGEMAP_HEAP));
+    return EXIT_SUCCESS;
+}
+
+int test_01_pagemap_clear() {
+    setenv(PAGEMAP_ENV, "1", 1);
+    pagemap_init();
+
+    char *base = (char *)(1UL << 40);
+    assert(pagemap_mark(base, 4 * PAGE, PAGEMAP_HEAP));
+
+    // Only the part of the first page below the range is kept
+    pagemap_clear(base + PAGE + 8, 2 * PAGE);
+    assert(pagemap_lookup(base) == PAGEMAP_HEAP);
+    assert(pagemap_lookup(base + PAGE + 7) == PAGEMAP_HEAP);
+    assert(pagemap_lookup(base + PAGE + 8) == PAGEMAP_NONE);
+    assert(pagemap_lookup(base + 2 * PAGE) == PAGEMAP_NONE);
+    assert(pagemap_lookup(base + 3 * PAGE) == PAGEMAP_NONE);
+
+    // Clearing pages that were never marked is harmless
+    pagemap_clear((char *)(1UL << 44), PAGE);
+    assert(pagemap_lookup((char *)(1UL << 44)) == PAGEMAP_NONE);
+    return EXIT_SUCCESS;
+}
+
+int test_02_pagemap_blocks() {
+    setenv(PAGEMAP_ENV, "1", 1);
+    pagemap_init();
+
+    Block *b0 = block_allocate(64);
+    Block *b1 = block_allocate(4 * PAGE);
+    assert(b0 && b1);
+    assert(pagemap_lookup(b0) == PAGEMAP_HEAP);
+    assert(pagemap_lookup(b0->data + b0->capacity - 1) == PAGEMAP_HEAP);
+    assert(pagemap_lookup(b1->data + b1->capacity - 1) == PAGEMAP_HEAP);
+
+    // Releasing the top of the heap forgets it (but not b0 on the same page)
+    char *end = b1->data + b1->capacity;
+    assert(block_release(b1));
+    assert(pagemap_lookup(b0->data + b0->capacity - 1) == PAGEMAP_HEAP);
+    assert(pagemap_lookup(b1) == PAGEMAP_NONE);
+    assert(pagemap_lookup(end - 1) == PAGEMAP_NONE);
+    return EXIT_SUCCESS;
+}
+
+int test_03_pagemap_shared() {
+    setenv(PAGEMAP_ENV, "1", 1);
+    pagemap_init();
+
+    char *base = (char *)(1UL << 40);
+    assert(pagemap_mark(base + 100, PAGE, PAGEMAP_HEAP));
+
+    // Adjacent ranges grow the range of a shared page
+    assert(pagemap_mark(base + PAGE + 100, 100, PAGEMAP_HEAP));
+    assert(pagemap_lookup(base + PAGE + 199) == PAGEMAP_HEAP);
+    assert(pagemap_lookup(base + PAGE + 200) == PAGEMAP_NONE);
+
+    // Ranges apart from it are left out
+    assert(!pagemap_mark(base + PAGE + 1000, 100, PAGEMAP_HEAP));
+    assert(pagemap_lookup(base + PAGE + 1000) == PAGEMAP_NONE);
+    assert(pagemap_lookup(base + PAGE) == PAGEMAP_HEAP);
+
+    // Filling the rest of the page marks all of it
+    assert(pagemap_mark(base + PAGE + 200, PAGE - 200, PAGEMAP_HEAP));
+    assert(pagemap_lookup(base + PAGE + 1000) == PAGEMAP_HEAP);
+    assert(pagemap_lookup(base + 2 * PAGE - 1) == PAGEMAP_HEAP);
+    assert(pagemap_lookup(base + 99) == PAGEMAP_NONE);
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test pagemap_mark\n");
+        fprintf(stderr, "    1. Test pagemap_clear\n");
+        fprintf(stderr, "    2. Test pagemap_blocks\n");
+        fprintf(stderr, "    3. Test pagemap_shared\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_pagemap_mark(); break;
+        case 1:  status = test_01_pagemap_clear(); break;
+        case 2:  status = test_02_pagemap_blocks(); break;
+        case 3:  status = test_03_pagemap_shared(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
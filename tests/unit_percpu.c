@@ -0,0 +1,284 @@
+/* unit_percpu.c: Unit tests for per-CPU caches */
+
+#define _GNU_SOURCE     /* For sched_setaffinity */
+
+#include "malloc/block.h"
+#include "malloc/counters.h"
+#include "malloc/percpu.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/sysinfo.h>
+
+/* Constants */
+
+#define THREADS     4
+#define HELD        8
+#define ROUNDS      100000
+
+/* Functions */
+
+bool pin_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+int test_00_percpu_push() {
+    assert(pin_cpu(sched_getcpu()));
+    percpu_init();
+    assert(PerCpuEnabled);
+
+    Block *b0 = block_allocate(32);
+    Block *b1 = block_allocate(48);
+    Block *b2 = block_allocate(PERCPU_MAX + PERCPU_CLASS);
+    assert(b0 && b1 && b2);
+
+    assert(percpu_push(b0));
+    assert(percpu_push(b1));
+    assert(!percpu_push(b2));
+
+    assert(percpu_pop(40) == b1);
+    assert(b1->size == 40);
+    assert(percpu_pop(40) == NULL);
+    assert(percpu_pop(17) == b0);
+    assert(b0->size == 17);
+    assert(percpu_pop(17) == NULL);
+    return EXIT_SUCCESS;
+}
+
+int test_01_percpu_depth() {
+    Block *blocks[PERCPU_DEPTH + 1];
+
+    assert(pin_cpu(sched_getcpu()));
+    for (int rseq = 1; rseq >= 0; rseq--) {
+        percpu_init();
+        PerCpuRseq = PerCpuRseq && rseq;
+
+        for (size_t i = 0; i <= PERCPU_DEPTH; i++) {
+            blocks[i] = block_allocate(64);
+            assert(blocks[i]);
+            assert(percpu_push(blocks[i]) == (i < PERCPU_DEPTH));
+        }
+
+        for (size_t i = PERCPU_DEPTH; i > 0; i--) {
+            assert(percpu_pop(64) == blocks[i - 1]);
+        }
+        assert(percpu_pop(64) == NULL);
+    }
+    return EXIT_SUCCESS;
+}
+
+void *percpu_thread(void *arg) {
+    Block **held = arg;
+
+    for (size_t round = 0; round < ROUNDS; round++) {
+        for (size_t i = 0; i < HELD; i++) {
+            if (held[i] && percpu_push(held[i])) {
+                held[i] = NULL;
+            }
+        }
+
+        for (size_t i = 0; i < HELD; i++) {
+            if (!held[i]) {
+                held[i] = percpu_pop(32);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+int test_02_percpu_threads() {
+    static Block *held[THREADS][HELD];
+    static Block *blocks[THREADS * HELD];
+    pthread_t     threads[THREADS];
+
+    for (int rseq = 1; rseq >= 0; rseq--) {
+        percpu_init();
+        PerCpuRseq = PerCpuRseq && rseq;
+
+        for (size_t i = 0; i < THREADS * HELD; i++) {
+            blocks[i] = block_allocate(32);
+            assert(blocks[i]);
+            held[i / HELD][i % HELD] = blocks[i];
+        }
+
+        for (size_t t = 0; t < THREADS; t++) {
+            assert(pthread_create(&threads[t], NULL, percpu_thread, held[t]) == 0);
+        }
+
+        for (size_t t = 0; t < THREADS; t++) {
+            assert(pthread_join(threads[t], NULL) == 0);
+        }
+
+        // Every block is either held by a thread or cached exactly once
+        size_t seen[THREADS * HELD] = {0};
+        Block *block;
+        for (int cpu = 0; cpu < get_nprocs_conf(); cpu++) {
+            if (!pin_cpu(cpu)) {
+                continue;
+            }
+
+            while ((block = percpu_pop(32))) {
+                for (size_t i = 0; i < THREADS * HELD; i++) {
+                    seen[i] += blocks[i] == block;
+                }
+            }
+        }
+
+        for (size_t t = 0; t < THREADS; t++) {
+            for (size_t h = 0; h < HELD; h++) {
+                for (size_t i = 0; i < THREADS * HELD; i++) {
+                    seen[i] += blocks[i] == held[t][h];
+                }
+            }
+        }
+
+        for (size_t i = 0; i < THREADS * HELD; i++) {
+            assert(seen[i] == 1);
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+int test_03_percpu_push_unrounded() {
+    assert(pin_cpu(sched_getcpu()));
+    percpu_init();
+
+    // Blocks not rounded up to a size class are kept in the class below
+    Block *b0 = block_allocate(PERCPU_CLASS + 8);
+    Block *b1 = block_allocate(PERCPU_MAX - 8);
+    assert(b0 && b1);
+    assert(b0->capacity % PERCPU_CLASS && b1->capacity % PERCPU_CLASS);
+
+    assert(percpu_push(b0));
+    assert(percpu_push(b1));
+    assert(percpu_pop(PERCPU_CLASS + 8) == NULL);
+    assert(percpu_pop(PERCPU_CLASS) == b0);
+    assert(percpu_pop(PERCPU_MAX) == NULL);
+    assert(percpu_pop(PERCPU_MAX - PERCPU_CLASS) == b1);
+    return EXIT_SUCCESS;
+}
+
+int test_04_percpu_collect() {
+    assert(pin_cpu(sched_getcpu()));
+    percpu_init();
+
+    Block *b0 = block_allocate(32);
+    Block *b1 = block_allocate(32);
+    assert(b0 && b1);
+    size_t mallocs   = Counters[MALLOCS];
+    size_t frees     = Counters[FREES];
+    size_t requested = Counters[REQUESTED];
+
+    assert(percpu_push(b0));
+    assert(percpu_push(b1));
+    assert(percpu_pop(20) == b1);
+    assert(Counters[MALLOCS] == mallocs);
+
+    // The counts of the caches are only added once
+    percpu_collect();
+    percpu_collect();
+    assert(Counters[MALLOCS]   == mallocs + 1);
+    assert(Counters[FREES]     == frees + 2);
+    assert(Counters[REQUESTED] == requested + 20);
+
+    assert(percpu_pop(30) == b0);
+    percpu_collect();
+    assert(Counters[MALLOCS]   == mallocs + 2);
+    assert(Counters[REQUESTED] == requested + 50);
+    return EXIT_SUCCESS;
+}
+
+int test_05_percpu_push_sized() {
+    assert(pin_cpu(sched_getcpu()));
+    percpu_init();
+
+    // The requested size picks the class, whatever the header says
+    Block *b0 = block_allocate(PERCPU_SIZE(20));
+    Block *b1 = block_allocate(PERCPU_MAX);
+    assert(b0 && b1);
+    b0->capacity = 0;
+
+    assert(percpu_push_sized(b0, 20));
+    assert(percpu_push_sized(b1, PERCPU_MAX - 1));
+    assert(percpu_length() == 2);
+    assert(percpu_bytes() == PERCPU_SIZE(20) + PERCPU_MAX);
+    assert(!percpu_push_sized(b1, PERCPU_MAX + 1));
+    assert(!percpu_push_sized(b1, 0));
+
+    assert(percpu_pop(17) == b0);
+    assert(percpu_pop(PERCPU_MAX) == b1);
+    assert(percpu_pop(PERCPU_MAX) == NULL);
+    return EXIT_SUCCESS;
+}
+
+int test_06_percpu_publish() {
+    assert(pin_cpu(sched_getcpu()));
+    percpu_init();
+
+    Block *b0 = block_allocate(32);
+    Block *b1 = block_allocate(64);
+    assert(b0 && b1);
+    assert(percpu_push(b0));
+    assert(percpu_push(b1));
+    assert(percpu_pop(30) == b0);
+
+    // Only the entries of the CPUs that exist are filled in
+    StatsCpu cpus[STATS_CPUS] = {{0}};
+    size_t   count = percpu_publish(cpus, STATS_CPUS);
+    assert(count == (size_t)get_nprocs_conf() || count == STATS_CPUS);
+    assert(percpu_publish(cpus, 1) == 1);
+
+    size_t mallocs = 0, frees = 0, cached = 0, bytes = 0;
+    count = percpu_publish(cpus, STATS_CPUS);
+    for (size_t cpu = 0; cpu < count; cpu++) {
+        mallocs += cpus[cpu].mallocs;
+        frees   += cpus[cpu].frees;
+        cached  += cpus[cpu].cached;
+        bytes   += cpus[cpu].cached_bytes;
+    }
+    assert(mallocs == 1 && frees == 2);
+    assert(cached == 1 && bytes == 64);
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test percpu_push\n");
+        fprintf(stderr, "    1. Test percpu_depth\n");
+        fprintf(stderr, "    2. Test percpu_threads\n");
+        fprintf(stderr, "    3. Test percpu_push_unrounded\n");
+        fprintf(stderr, "    4. Test percpu_collect\n");
+        fprintf(stderr, "    5. Test percpu_push_sized\n");
+        fprintf(stderr, "    6. Test percpu_publish\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_percpu_push(); break;
+        case 1:  status = test_01_percpu_depth(); break;
+        case 2:  status = test_02_percpu_threads(); break;
+        case 3:  status = test_03_percpu_push_unrounded(); break;
+        case 4:  status = test_04_percpu_collect(); break;
+        case 5:  status = test_05_percpu_push_sized(); break;
+        case 6:  status = test_06_percpu_publish(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,118 @@
+/* unit_profile.c: Unit tests for sampling heap profiler */
+
+#include "malloc/profile.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Constants */
+
+#define PROFILE_PATH    "/tmp/unit_profile.heap"
+
+/* Functions */
+
+int test_00_profile_init() {
+    unsetenv(PROFILE_ENV);
+    profile_init();
+    assert(ProfileEnabled == false);
+
+    setenv(PROFILE_ENV, "/dev/null", 1);
+    setenv(PROFILE_RATE_ENV, "1", 1);
+    profile_init();
+    assert(ProfileEnabled == true);
+    assert(ProfileLive == 0);
+    return EXIT_SUCCESS;
+}
+
+int test_01_profile_malloc() {
+    setenv(PROFILE_ENV, "/dev/null", 1);
+    setenv(PROFILE_RATE_ENV, "1", 1);
+    profile_init();
+
+    char heap[PROFILE_SAMPLES << 4];
+    for (size_t i = 0; i < PROFILE_SAMPLES; i++) {
+        profile_malloc(heap + (i << 4), 1000);
+    }
+    assert(ProfileLive == PROFILE_SAMPLES);
+
+    profile_malloc(heap, 1000);
+    assert(ProfileLive == PROFILE_SAMPLES);
+
+    for (size_t i = 0; i < PROFILE_SAMPLES; i += 2) {
+        profile_free(heap + (i << 4));
+    }
+    assert(ProfileLive == PROFILE_SAMPLES / 2);
+
+    profile_free(heap + 8);
+    assert(ProfileLive == PROFILE_SAMPLES / 2);
+
+    profile_move(heap + 16, heap);
+    profile_free(heap + 16);
+    assert(ProfileLive == PROFILE_SAMPLES / 2);
+
+    for (size_t i = 1; i < PROFILE_SAMPLES; i += 2) {
+        profile_free(i == 1 ? heap : heap + (i << 4));
+    }
+    assert(ProfileLive == 0);
+    return EXIT_SUCCESS;
+}
+
+int test_02_profile_dump() {
+    assert(profile_dump(PROFILE_PATH) == false);
+
+    setenv(PROFILE_ENV, "/dev/null", 1);
+    setenv(PROFILE_RATE_ENV, "1", 1);
+    profile_init();
+
+    char heap[64];
+    profile_malloc(heap, 1000);
+    profile_malloc(heap + 16, 2000);
+    assert(profile_dump(PROFILE_PATH) == true);
+
+    FILE *fs = fopen(PROFILE_PATH, "r");
+    assert(fs);
+
+    char   line[BUFSIZ];
+    size_t samples = 0;
+    assert(fgets(line, BUFSIZ, fs));
+    assert(strstr(line, "heap profile:      2:     3000 [") == line);
+    assert(strstr(line, "@ heap_v2/1"));
+    while (fgets(line, BUFSIZ, fs) && strstr(line, " @ ")) {
+        samples++;
+    }
+    assert(samples == 2);
+    assert(fgets(line, BUFSIZ, fs) && !strcmp(line, "MAPPED_LIBRARIES:\n"));
+
+    fclose(fs);
+    unlink(PROFILE_PATH);
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test profile_init\n");
+        fprintf(stderr, "    1. Test profile_malloc\n");
+        fprintf(stderr, "    2. Test profile_dump\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_profile_init(); break;
+        case 1:  status = test_01_profile_malloc(); break;
+        case 2:  status = test_02_profile_dump(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
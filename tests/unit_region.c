@@ -0,0 +1,107 @@
+/* unit_region.c: Unit tests for regions */
+
+#include "malloc/block.h"
+#include "malloc/counters.h"
+#include "malloc/freelist.h"
+#include "malloc/region.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Functions */
+
+int test_00_region_alloc() {
+    Region *region = region_create();
+    assert(region);
+    assert(region_alloc(region, 0) == NULL);
+
+    char *p0 = region_alloc(region, 1);
+    char *p1 = region_alloc(region, 20);
+    char *p2 = region_alloc(region, 8);
+    assert(p0 && p1 && p2);
+    assert(p1 == p0 + ALIGN(1));
+    assert(p2 == p1 + ALIGN(20));
+    assert((uintptr_t)p2 % ALIGNMENT == 0);
+
+    // Filling the first chunk takes a new one
+    size_t chunks = Counters[REGION_CHUNKS];
+    for (size_t i = 0; i < REGION_CHUNK / REGION_LARGE; i++) {
+        char *p = region_alloc(region, REGION_LARGE);
+        assert(p);
+        memset(p, 0, REGION_LARGE);
+    }
+    assert(Counters[REGION_CHUNKS] == chunks + 1);
+    return EXIT_SUCCESS;
+}
+
+int test_01_region_large() {
+    Region *region = region_create();
+    assert(region);
+
+    char *p0 = region_alloc(region, 16);
+    char *p1 = region_alloc(region, REGION_CHUNK * 2);
+    char *p2 = region_alloc(region, 16);
+    assert(p0 && p1 && p2);
+
+    // Large allocations do not take over the current chunk
+    assert(p2 == p0 + 16);
+    assert(region->chunks == BLOCK_FROM_POINTER(p1));
+    assert(region->chunks->capacity >= REGION_CHUNK * 2);
+    assert(Counters[REGION_CHUNKS] == 2);
+    return EXIT_SUCCESS;
+}
+
+int test_02_region_reset() {
+    Region *region = region_create();
+    assert(region);
+
+    char *p0 = region_alloc(region, 16);
+    for (size_t i = 0; i < 4 * REGION_CHUNK / REGION_LARGE; i++) {
+        assert(region_alloc(region, REGION_LARGE));
+    }
+    assert(region_alloc(region, REGION_CHUNK));
+    assert(region->chunks);
+
+    region_reset(region);
+    assert(region->chunks == NULL);
+    assert(region_alloc(region, 16) == p0);
+    assert(Counters[REGION_ALLOCS] == 2 + 4 * REGION_CHUNK / REGION_LARGE);
+    assert(Counters[REGION_BYTES] == 16 + 4 * REGION_CHUNK + REGION_CHUNK);
+    assert(Counters[REGION_RESETS] == 1);
+
+    // Only the chunk that holds the region is left (the others were on top)
+    assert(Counters[HEAP_SIZE] == sizeof(Block) + region->first->capacity);
+
+    region_destroy(region);
+    assert(Counters[HEAP_SIZE] == 0);
+    assert(free_list_length() == 0);
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test region_alloc\n");
+        fprintf(stderr, "    1. Test region_large\n");
+        fprintf(stderr, "    2. Test region_reset\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_region_alloc(); break;
+        case 1:  status = test_01_region_large(); break;
+        case 2:  status = test_02_region_reset(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
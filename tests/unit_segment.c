@@ -0,0 +1,195 @@
+/* unit_segment.c: Unit tests for segmented heap */
+
+#include "malloc/block.h"
+#include "malloc/counters.h"
+#include "malloc/freelist.h"
+#include "malloc/segment.h"
+
+#include <assert.h>
+#include <string.h>
+
+/* Externals */
+
+extern Block *free_list_search_ff(size_t size);
+
+/* Constants */
+
+#define MAX_BLOCKS  1024
+
+/* Functions */
+
+int test_00_segment_allocate() {
+    setenv(SEGMENTS_ENV, "1", 1);
+    segment_init();
+    assert(SegmentsEnabled);
+
+    Block *b0 = block_allocate(64);
+    Block *b1 = block_allocate(64);
+    assert(b0 && b1);
+    assert((char *)b1 == b0->data + b0->capacity);
+    assert(segment_find(b0) == segment_find(b1));
+    assert(segment_find(b0)->start + SEGMENT_GUARD == (char *)b0);
+    assert(segment_count() == 1);
+
+    // Large blocks get a segment of their own, which goes away with them
+    Block *b2 = block_allocate(SEGMENT_MIN);
+    assert(b2);
+    assert(segment_find(b2) != segment_find(b0));
+    assert(segment_count() == 2);
+    memset(b2->data, 1, b2->capacity);
+
+    assert(block_release(b2) == true);
+    assert(segment_count() == 1);
+    assert(Counters[SEGMENT_UNMAPS] == 1);
+    assert(Counters[HEAP_SIZE] == 2 * (sizeof(Block) + 64));
+
+    // The top of the current segment is lowered instead
+    Block *b3 = block_allocate(TRIM_THRESHOLD);
+    assert(b3);
+    assert(block_at_top(b3));
+    assert(block_release(b3) == true);
+    assert(block_at_top(b1));
+    assert(block_release(b1) == false);
+    assert(segment_count() == 1);
+    return EXIT_SUCCESS;
+}
+
+int test_01_segment_free() {
+    static Block *blocks[MAX_BLOCKS];
+
+    setenv(SEGMENTS_ENV, "1", 1);
+    segment_init();
+
+    // Fill the first segment until a second one becomes current
+    size_t count = 0;
+    while (segment_count() < 2) {
+        assert(count < MAX_BLOCKS);
+        blocks[count] = block_allocate(4000);
+        assert(blocks[count]);
+        count++;
+    }
+
+    Segment *first = segment_find(blocks[0]);
+    assert(segment_find(blocks[count - 1]) != first);
+
+    // The first segment is unmapped once all of its blocks are free
+    for (size_t i = 0; i + 1 < count; i += 2) {
+        free_list_insert(blocks[i]);
+    }
+    assert(segment_count() == 2);
+    assert(segment_find(blocks[0])->free > 0);
+
+    for (size_t i = 1; i + 1 < count; i += 2) {
+        free_list_insert(blocks[i]);
+    }
+    assert(segment_count() == 1);
+    assert(segment_find(blocks[0]) == NULL);
+    assert(free_list_length() == 0);
+    assert(Counters[BLOCKS] == 1);
+    assert(Counters[HEAP_SIZE] == sizeof(Block) + 4000);
+
+    // The current segment is kept even when all of its blocks are free
+    free_list_insert(blocks[count - 1]);
+    assert(segment_count() == 1);
+    assert(free_list_length() == 1);
+    return EXIT_SUCCESS;
+}
+
+int test_02_segment_take() {
+    setenv(SEGMENTS_ENV, "1", 1);
+    segment_init();
+
+    Block *b0 = block_allocate(1000);
+    Block *b1 = block_allocate(1000);
+    assert(b0 && b1);
+
+    Segment *segment = segment_find(b0);
+    free_list_insert(b0);
+    assert(segment->free == sizeof(Block) + 1000);
+
+    Block *b2 = free_list_search_ff(100);
+    assert(b2 == b0);
+    b2 = free_list_take(b2, 100);
+    assert(segment->free == 1000 - ALIGN(100));
+
+    free_list_insert(b2);
+    assert(segment->free == sizeof(Block) + 1000);
+    assert(free_list_length() == 1);
+    return EXIT_SUCCESS;
+}
+
+int test_03_segment_resize() {
+    setenv(SEGMENTS_ENV, "1", 1);
+    segment_init();
+
+    // Blocks of the current segment are not remapped
+    Block *b0 = block_allocate(64);
+    assert(b0);
+    assert(block_resize(b0, 4 * SEGMENT_MIN) == NULL);
+
+    Block *b1 = block_allocate(SEGMENT_MIN);
+    assert(b1);
+    for (size_t i = 0; i < SEGMENT_MIN; i++) {
+        b1->data[i] = i % 251;
+    }
+
+    // Growing keeps the data and the block stays alone in its segment
+    Block *b2 = block_resize(b1, 4 * SEGMENT_MIN);
+    assert(b2);
+    assert(b2->size == 4 * SEGMENT_MIN);
+    assert(b2->capacity >= 4 * SEGMENT_MIN);
+    assert(segment_find(b2)->start + SEGMENT_GUARD == (char *)b2);
+    assert(segment_find(b2)->top == b2->data + b2->capacity);
+    assert(segment_find(b0) != segment_find(b2));
+    assert(segment_count() == 2);
+    for (size_t i = 0; i < SEGMENT_MIN; i++) {
+        assert(b2->data[i] == (char)(i % 251));
+    }
+    memset(b2->data, 1, b2->capacity);
+
+    assert(Counters[REMAPS] == 1);
+    assert(Counters[REMAPPED] == SEGMENT_MIN);
+    assert(Counters[HEAP_SIZE] == 2 * sizeof(Block) + 64 + b2->capacity);
+    assert(Counters[SEGMENT_BYTES] == segment_find(b0)->length + segment_find(b2)->length);
+
+    // Shrinking gives the pages back
+    Block *b3 = block_resize(b2, SEGMENT_MIN / 2);
+    assert(b3);
+    assert(b3->capacity < SEGMENT_MIN);
+    assert(b3->data[SEGMENT_MIN / 2 - 1] == 1);
+    assert(Counters[HEAP_SIZE] == 2 * sizeof(Block) + 64 + b3->capacity);
+
+    assert(block_release(b3) == true);
+    assert(segment_count() == 1);
+    assert(Counters[HEAP_SIZE] == sizeof(Block) + 64);
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test segment_allocate\n");
+        fprintf(stderr, "    1. Test segment_free\n");
+        fprintf(stderr, "    2. Test segment_take\n");
+        fprintf(stderr, "    3. Test segment_resize\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_segment_allocate(); break;
+        case 1:  status = test_01_segment_free(); break;
+        case 2:  status = test_02_segment_take(); break;
+        case 3:  status = test_03_segment_resize(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,100 @@
+/* unit_sites.c: Unit tests for per call site statistics */
+
+#include "malloc/block.h"
+#include "malloc/sites.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Functions */
+
+int test_00_sites_malloc() {
+    Block *b0 = block_allocate(100);
+    Block *b1 = block_allocate(200);
+    assert(b0 && b1);
+
+    sites_malloc(b0, (void *)0x1000, 1, 0);
+    sites_malloc(b1, (void *)0x1000, 1, 2);
+    assert(b0->prev != b0);
+    assert(b0->prev == b1->prev);
+
+    Site *site = (Site *)b0->prev;
+    assert(site->address == (void *)0x1000);
+    assert(site->mallocs == 2);
+    assert(site->bytes   == 300);
+    assert(site->live    == 300);
+    assert(site->grows   == 2);
+    assert(site->splits  == 2);
+
+    assert(sites_free(b0) == site);
+    assert(b0->prev    == b0);
+    assert(site->live  == 200);
+    assert(sites_free(b0) == NULL);
+    assert(site->live  == 200);
+
+    sites_tag(b0, site);
+    assert(site->live  == 300);
+    assert(site->mallocs == 2);
+    return EXIT_SUCCESS;
+}
+
+int test_01_sites_dump() {
+    setenv(SITES_ENV, "2", 1);
+    sites_init();
+    assert(SitesEnabled);
+
+    Block *b0 = block_allocate(100);
+    assert(b0);
+    for (int i = 0; i < 3; i++) {
+        sites_malloc(b0, (void *)0x1000, 0, 0);
+        sites_free(b0);
+    }
+    for (int i = 0; i < 5; i++) {
+        sites_malloc(b0, (void *)0x2000, 0, 0);
+        sites_free(b0);
+    }
+    sites_malloc(b0, (void *)0x3000, 0, 0);
+
+    int fds[2];
+    assert(pipe(fds) == 0);
+    sites_dump(fds[1]);
+    close(fds[1]);
+
+    char buffer[BUFSIZ] = {0};
+    assert(read(fds[0], buffer, BUFSIZ - 1) > 0);
+    close(fds[0]);
+
+    char *first  = strstr(buffer, "mallocs: 5 ");
+    char *second = strstr(buffer, "mallocs: 3 ");
+    assert(strstr(buffer, "sites:\n") == buffer);
+    assert(first && second && first < second);
+    assert(strstr(buffer, "mallocs: 1 ") == NULL);
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test sites_malloc\n");
+        fprintf(stderr, "    1. Test sites_dump\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_sites_malloc(); break;
+        case 1:  status = test_01_sites_dump(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
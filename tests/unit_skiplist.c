@@ -0,0 +1,113 @@
+/* unit_skiplist.c: Unit tests for skip list index */
+
+#include "malloc/skiplist.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+/* Constants */
+
+#define N   (1<<12)
+
+/* Functions */
+
+Block   Blocks[N];
+bool    Indexed[N];
+
+Block *lower(Block *block) {
+    for (ssize_t i = block - Blocks - 1; i >= 0; i--) {
+        if (Indexed[i]) {
+            return &Blocks[i];
+        }
+    }
+    return NULL;
+}
+
+int test_00_skiplist_insert() {
+    assert(skiplist_lower(&Blocks[0]) == NULL);
+
+    for (size_t i = 0; i < N; i++) {
+        size_t j = (i * 2654435761UL) % N;
+        assert(skiplist_insert(&Blocks[j]));
+        Indexed[j] = true;
+    }
+    assert(skiplist_length() == N);
+    assert(skiplist_insert(&Blocks[0]));
+    assert(skiplist_length() == N);
+
+    for (size_t i = 0; i < N; i++) {
+        assert(skiplist_lower(&Blocks[i]) == (i ? &Blocks[i - 1] : NULL));
+    }
+    assert(skiplist_lower(&Blocks[N]) == &Blocks[N - 1]);
+    return EXIT_SUCCESS;
+}
+
+int test_01_skiplist_remove() {
+    for (size_t i = 0; i < N; i++) {
+        assert(skiplist_insert(&Blocks[i]));
+        Indexed[i] = true;
+    }
+
+    for (size_t i = 0; i < N; i++) {
+        size_t j = (i * 40503UL) % N;
+        if (j % 3) {
+            assert(skiplist_remove(&Blocks[j]));
+            assert(!skiplist_remove(&Blocks[j]));
+            Indexed[j] = false;
+        }
+    }
+
+    for (size_t i = 0; i <= N; i++) {
+        assert(skiplist_lower(&Blocks[i]) == lower(&Blocks[i]));
+    }
+
+    for (size_t i = 0; i < N; i++) {
+        if (Indexed[i]) {
+            assert(skiplist_remove(&Blocks[i]));
+        }
+    }
+    assert(skiplist_length() == 0);
+    assert(skiplist_lower(&Blocks[N]) == NULL);
+    return EXIT_SUCCESS;
+}
+
+int test_02_skiplist_replace() {
+    assert(skiplist_insert(&Blocks[10]));
+    assert(skiplist_insert(&Blocks[20]));
+    assert(!skiplist_replace(&Blocks[15], &Blocks[16]));
+
+    assert(skiplist_replace(&Blocks[20], &Blocks[15]));
+    assert(skiplist_lower(&Blocks[16]) == &Blocks[15]);
+    assert(skiplist_lower(&Blocks[15]) == &Blocks[10]);
+    assert(!skiplist_remove(&Blocks[20]));
+    assert(skiplist_remove(&Blocks[15]));
+    assert(skiplist_length() == 1);
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test skiplist_insert\n");
+        fprintf(stderr, "    1. Test skiplist_remove\n");
+        fprintf(stderr, "    2. Test skiplist_replace\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_skiplist_insert(); break;
+        case 1:  status = test_01_skiplist_remove(); break;
+        case 2:  status = test_02_skiplist_replace(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
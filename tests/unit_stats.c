@@ -0,0 +1,125 @@
+/* unit_stats.c: Unit tests for shared memory statistics */
+
+#include "malloc/block.h"
+#include "malloc/counters.h"
+#include "malloc/freelist.h"
+#include "malloc/stats.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Externals */
+
+extern Stats *StatsPage;
+
+/* Functions */
+
+int test_00_stats_init() {
+    unsetenv(STATS_ENV);
+    stats_init();
+    assert(StatsPage == NULL);
+
+    setenv(STATS_ENV, "1", 1);
+    stats_init();
+    assert(StatsPage);
+    assert(StatsPage->magic     == STATS_MAGIC);
+    assert(StatsPage->version   == STATS_VERSION);
+    assert(StatsPage->ncounters == NCOUNTERS);
+    assert(StatsPage->narenas   == STATS_ARENAS);
+    assert(StatsPage->pid       == getpid());
+    assert(StatsPage->updates   == 1);
+    assert(StatsPage->sequence  == 2);
+
+    char name[BUFSIZ];
+    sprintf(name, STATS_NAME, getpid());
+    int fd = shm_open(name, O_RDONLY, 0);
+    assert(fd >= 0);
+    close(fd);
+    return EXIT_SUCCESS;
+}
+
+int test_01_stats_publish() {
+    setenv(STATS_ENV, "1", 1);
+    stats_init();
+    assert(StatsPage);
+
+    Block *b0 = block_allocate(100);
+    Block *b1 = block_allocate(200);
+    Block *b2 = block_allocate(300);
+    assert(b0 && b1 && b2);
+    free_list_insert(b0);
+    free_list_insert(b2);
+
+    // Free list is only scanned every STATS_INTERVAL updates
+    stats_publish();
+    assert(StatsPage->sequence     == 4);
+    assert(StatsPage->free_blocks  == 0);
+    assert(StatsPage->counters[GROWS] == 3);
+
+    while (StatsPage->updates % STATS_INTERVAL) {
+        stats_publish();
+    }
+    stats_publish();
+    assert(StatsPage->sequence % 2  == 0);
+    assert(StatsPage->free_blocks  == 2);
+    assert(StatsPage->free_bytes   == ALIGN(100) + ALIGN(300));
+    assert(StatsPage->largest_free == ALIGN(300));
+    assert(!memcmp(StatsPage->counters, Counters, sizeof(Counters)));
+
+    // The remote frees still queued are those not drained yet
+    Counters[REMOTE_FREES] += 5;
+    Counters[DRAINS]       += 1;
+    Counters[DRAINED]      += 3;
+    stats_publish();
+    assert(StatsPage->arenas[0].remote_frees == Counters[REMOTE_FREES]);
+    assert(StatsPage->arenas[0].drains       == Counters[DRAINS]);
+    assert(StatsPage->arenas[0].queued       == 2);
+    return EXIT_SUCCESS;
+}
+
+int test_02_stats_fini() {
+    setenv(STATS_ENV, "1", 1);
+    stats_init();
+    assert(StatsPage);
+
+    stats_fini();
+    assert(StatsPage == NULL);
+
+    char name[BUFSIZ];
+    sprintf(name, STATS_NAME, getpid());
+    assert(shm_open(name, O_RDONLY, 0) < 0);
+
+    stats_publish();
+    stats_fini();
+    return EXIT_SUCCESS;
+}
+
+/* Main execution */
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NUMBER\n\n", argv[0]);
+        fprintf(stderr, "Where NUMBER is right of the following:\n");
+        fprintf(stderr, "    0. Test stats_init\n");
+        fprintf(stderr, "    1. Test stats_publish\n");
+        fprintf(stderr, "    2. Test stats_fini\n");
+        return EXIT_FAILURE;
+    }
+
+    int number = atoi(argv[1]);
+    int status = EXIT_FAILURE;
+
+    switch (number) {
+        case 0:  status = test_00_stats_init(); break;
+        case 1:  status = test_01_stats_publish(); break;
+        case 2:  status = test_02_stats_fini(); break;
+        default: fprintf(stderr, "Unknown NUMBER: %d\n", number); break;
+    }
+
+    return status;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */
@@ -0,0 +1,244 @@
+/* mstat.c: display allocator statistics of a running process */
+
+#include "malloc/adaptive.h"
+#include "malloc/stats.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Constants */
+
+#define HEADER_INTERVAL 20
+
+/* Functions */
+
+void usage(const char *program, int status) {
+    fprintf(stderr, "Usage: %s PID [DELAY [COUNT]]\n\n", program);
+    fprintf(stderr, "Where PID is a process running with %s=1 and libmalloc preloaded.\n", STATS_ENV);
+    exit(status);
+}
+
+/**
+ * Map the stats page of the specified process read-only.
+ * @param   pid     Process ID of the target process.
+ * @return  Pointer to the mapped stats page (otherwise NULL on failure).
+ **/
+const Stats *stats_attach(pid_t pid) {
+    char name[BUFSIZ];
+    sprintf(name, STATS_NAME, pid);
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Unable to open %s: %s\n", name, strerror(errno));
+        return NULL;
+    }
+
+    struct stat s;
+    if (fstat(fd, &s) < 0 || s.st_size < (off_t)sizeof(Stats)) {
+        fprintf(stderr, "Unable to use %s: segment is too small\n", name);
+        close(fd);
+        return NULL;
+    }
+
+    const Stats *page = mmap(NULL, sizeof(Stats), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        fprintf(stderr, "Unable to map %s: %s\n", name, strerror(errno));
+        return NULL;
+    }
+
+    if (__atomic_load_n(&page->magic, __ATOMIC_ACQUIRE) != STATS_MAGIC || page->version != STATS_VERSION) {
+        fprintf(stderr, "Unable to use %s: unknown stats page format\n", name);
+        munmap((void *)page, sizeof(Stats));
+        return NULL;
+    }
+
+    return page;
+}
+
+/**
+ * Take a consistent snapshot of the stats page using the seqlock protocol.
+ * @param   page        Pointer to the mapped stats page.
+ * @param   snapshot    Pointer to where the snapshot is stored.
+ **/
+void    stats_snapshot(const Stats *page, Stats *snapshot) {
+    uint32_t before, after;
+
+    do {
+        before = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            continue;
+        }
+
+        memcpy(snapshot, page, sizeof(Stats));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after  = __atomic_load_n(&page->sequence, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+
+    if (snapshot->ncounters < NCOUNTERS) {
+        memset(snapshot->counters + snapshot->ncounters, 0, (NCOUNTERS - snapshot->ncounters) * sizeof(size_t));
+    }
+}
+
+/**
+ * Compute rate of change of a counter between two snapshots.
+ **/
+double  rate(const Stats *prev, const Stats *curr, int counter, double elapsed) {
+    return (curr->counters[counter] - prev->counters[counter]) / elapsed;
+}
+
+void    print_header() {
+    printf("%10s %8s %8s %10s %10s %10s %8s %8s %8s %8s %6s\n",
+        "heap(KiB)", "blocks", "free", "mallocs/s", "frees/s", "reuses/s",
+        "grows/s", "shrink/s", "splits/s", "merges/s", "ext%");
+}
+
+void    print_row(const Stats *prev, const Stats *curr, double elapsed) {
+    double external = 0;
+    if (curr->free_bytes) {
+        external = (1 - (double)curr->largest_free / curr->free_bytes) * 100.0;
+    }
+
+    printf("%10lu %8lu %8lu %10.0lf %10.0lf %10.0lf %8.0lf %8.0lf %8.0lf %8.0lf %6.2lf\n",
+        curr->counters[HEAP_SIZE] / 1024,
+        curr->counters[BLOCKS],
+        curr->free_blocks,
+        rate(prev, curr, MALLOCS, elapsed),
+        rate(prev, curr, FREES, elapsed),
+        rate(prev, curr, REUSES, elapsed),
+        rate(prev, curr, GROWS, elapsed),
+        rate(prev, curr, SHRINKS, elapsed),
+        rate(prev, curr, SPLITS, elapsed),
+        rate(prev, curr, MERGES, elapsed),
+        external);
+    fflush(stdout);
+}
+
+/**
+ * Display the remote frees and drains of every arena that had any between two
+ * snapshots.
+ **/
+void    print_arenas(const Stats *prev, const Stats *curr, double elapsed) {
+    for (uint32_t i = 0; i < curr->narenas && i < STATS_ARENAS; i++) {
+        const StatsArena *before = &prev->arenas[i];
+        const StatsArena *after  = &curr->arenas[i];
+        size_t            drains = after->drains - before->drains;
+
+        if (after->remote_frees == before->remote_frees && !drains) {
+            continue;
+        }
+
+        printf("# arena %u: %.0lf remote frees/s, %.0lf drains/s (%.2lf blocks each, max %lu), %lu queued\n",
+            i, (after->remote_frees - before->remote_frees) / elapsed, drains / elapsed,
+            drains ? (double)(after->drained - before->drained) / drains : 0,
+            after->drain_max, after->queued);
+    }
+}
+
+/**
+ * Display the hits, frees and cached blocks of every per-CPU cache that served
+ * any malloc or free between two snapshots.
+ **/
+void    print_cpus(const Stats *prev, const Stats *curr, double elapsed) {
+    for (uint32_t i = 0; i < curr->ncpus && i < STATS_CPUS; i++) {
+        const StatsCpu *before = &prev->cpus[i];
+        const StatsCpu *after  = &curr->cpus[i];
+
+        if (after->mallocs == before->mallocs && after->frees == before->frees) {
+            continue;
+        }
+
+        printf("# cpu %u: %.0lf hits/s, %.0lf frees/s, %lu cached (%lu KiB)\n",
+            i, (after->mallocs - before->mallocs) / elapsed, (after->frees - before->frees) / elapsed,
+            after->cached, after->cached_bytes / 1024);
+    }
+}
+
+/**
+ * Display the switches of the adaptive policy that were logged between two
+ * snapshots (as far as the log still holds them).
+ **/
+void    print_switches(const Stats *prev, const Stats *curr) {
+    size_t first = prev->switches;
+    if (curr->switches - first > STATS_SWITCHES) {
+        first = curr->switches - STATS_SWITCHES;
+    }
+
+    for (size_t i = first; i < curr->switches; i++) {
+        const StatsSwitch *entry = &curr->log[i % STATS_SWITCHES];
+        printf("# policy %s -> %s at %.3lf s (free %lu%%, %lu blocks/search)\n",
+            adaptive_name(entry->from), adaptive_name(entry->to),
+            (entry->time - curr->started) / 1e9, entry->free_ratio, entry->steps);
+    }
+}
+
+double  now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Main Execution */
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 4) {
+        usage(argv[0], EXIT_FAILURE);
+    }
+
+    pid_t  pid   = atoi(argv[1]);
+    double delay = argc > 2 ? atof(argv[2]) : 1.0;
+    long   count = argc > 3 ? atol(argv[3]) : -1;
+
+    if (pid <= 0 || delay <= 0) {
+        usage(argv[0], EXIT_FAILURE);
+    }
+
+    const Stats *page = stats_attach(pid);
+    if (!page) {
+        return EXIT_FAILURE;
+    }
+
+    // The first row reports averages since the process started (like vmstat)
+    Stats  prev = {0};
+    Stats  curr;
+    double last = page->started / 1e9;
+
+    stats_snapshot(page, &curr);
+    for (long row = 0; count < 0 || row < count; row++) {
+        if (row % HEADER_INTERVAL == 0) {
+            print_header();
+        }
+
+        double current = now();
+        double elapsed = current - last;
+        print_switches(&prev, &curr);
+        print_arenas(&prev, &curr, elapsed > 0 ? elapsed : 1.0);
+        print_cpus(&prev, &curr, elapsed > 0 ? elapsed : 1.0);
+        print_row(&prev, &curr, elapsed > 0 ? elapsed : 1.0);
+        last = current;
+        prev = curr;
+
+        if (count >= 0 && row + 1 >= count) {
+            break;
+        }
+
+        usleep(delay * 1000000);
+        if (kill(pid, 0) < 0 && errno == ESRCH) {
+            break;
+        }
+        stats_snapshot(page, &curr);
+    }
+
+    munmap((void *)page, sizeof(Stats));
+    return EXIT_SUCCESS;
+}
+
+/* vim: set expandtab sts=4 sw=4 ts=8 ft=c: */